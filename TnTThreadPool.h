@@ -26,284 +26,3699 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <cstddef>
 #include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <future>
+#include <latch>
+#include <limits>
+#include <list>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <semaphore>
+#include <span>
+#include <stdexcept>
+#include <system_error>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-#include <functional>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#   define TNT_HAS_PTHREAD 1
+#   include <alloca.h>
+#   include <climits>
+#   include <pthread.h>
+#   include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#   include <cmath>
+#   include <fstream>
+#   include <sched.h>
+#   include <string>
+#   include <sys/resource.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#   define TNT_HAS_IO_URING 1
+#   include <cerrno>
+#   include <linux/io_uring.h>
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<sys/epoll.h>)
+#   define TNT_HAS_EPOLL 1
+#   include <cerrno>
+#   include <sys/epoll.h>
+#   include <unistd.h>
+#endif
 
 namespace TnT {
 
-   class TnTThreadPool {
-     public:
-      TnTThreadPool(std::size_t threadCount = static_cast<std::size_t>(std::thread::hardware_concurrency())) : m_threadCount(threadCount) { init(); }
+   class blockingRegion;
 
-      ~TnTThreadPool() { cleanUp(); }
+#if defined(__linux__)
+   namespace detail {
+      /// @brief Reads a cgroup v2 cpu.max file ("<quota> <period>" or "max <period>") from @paramref directory.
+      /// @returns The quota rounded up to whole CPUs, or std::nullopt if the group is unlimited or the file is missing or malformed.
+      [[nodiscard]] inline std::optional<std::size_t> readCgroupV2CpuLimit(const std::string& directory) {
+         auto parse = [](const std::string& text, double& value) {
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return error == std::errc{} && end == text.data() + text.size();
+         };
 
-      /// @brief Submits a job to the thread pool queue for execution.
-      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-      /// @tparam Args [Optional] Arguments to provide to the job.
-      /// @param job The job to execute.
-      /// @param args Arguments to provide to the job.
-      template<typename Job, typename... Args>
-      inline void submit(Job&& job, Args&&... args) {
-         if constexpr(sizeof...(Args) == 0) {
-            queueJob(std::forward<Job>(job));
+         std::ifstream file{ directory + "/cpu.max" };
+         std::string   quotaText;
+         std::string   periodText;
+         double        quota  = 0;
+         double        period = 0;
+         if(!(file >> quotaText >> periodText) || quotaText == "max" || !parse(quotaText, quota) || !parse(periodText, period) || quota < 0 || period <= 0) {
+            return std::nullopt;
          }
-         else {
-            // Convert job and args to lambda calling job with the args provided so that it matches the signature of void().
-            submit([job = std::forward<Job>(job), ... args = std::forward<Args>(args)]() mutable { job(args...); });
+         return static_cast<std::size_t>(std::ceil(quota / period));
+      }
+
+      /// @brief Reads the cgroup v1 cpu.cfs_quota_us and cpu.cfs_period_us files from @paramref directory.
+      /// @returns The quota rounded up to whole CPUs, or std::nullopt if the group is unlimited (a quota of -1) or the files are missing.
+      [[nodiscard]] inline std::optional<std::size_t> readCgroupV1CpuLimit(const std::string& directory) {
+         std::ifstream quotaFile{ directory + "/cpu.cfs_quota_us" };
+         std::ifstream periodFile{ directory + "/cpu.cfs_period_us" };
+         double        quota  = 0;
+         double        period = 0;
+         if(!(quotaFile >> quota) || !(periodFile >> period) || quota <= 0 || period <= 0) {
+            return std::nullopt;
          }
+         return static_cast<std::size_t>(std::ceil(quota / period));
       }
 
-      /// @brief Submits a job to the thread pool queue and allows the user to retrieve a return value from the job.
-      /// @tparam ReturnValue The return value of the job.
-      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-      /// @tparam Args [Optional] Arguments to provide to the job.
-      /// @param job The job to execute.
-      /// @param args Arguments to provide to the job.
-      /// @returns An std::future of the return value. To wait for the return value use future.wait() or one of its alternate forms.
-      template<typename ReturnValue, typename Job, typename... Args>
-      [[nodiscard]] inline std::future<ReturnValue> submitForReturn(Job&& job, Args&&... args) {
-         std::promise<ReturnValue>* promise = new std::promise<ReturnValue>{};
-         std::future<ReturnValue>   future  = promise->get_future();
+      /// @brief Applies @paramref readLimit to @paramref path under @paramref mount and every ancestor up to the mount, as any of them may carry the effective quota.
+      template<typename ReadLimit>
+      [[nodiscard]] inline std::optional<std::size_t> tightestCgroupCpuLimit(const std::string& mount, std::string path, ReadLimit readLimit) {
+         std::optional<std::size_t> limit;
+         while(true) {
+            if(auto found = readLimit(mount + path); found && (!limit || *found < *limit)) {
+               limit = found;
+            }
+            if(path.empty() || path == "/") {
+               return limit;
+            }
+            path.erase(path.find_last_of('/'));
+         }
+      }
 
-         auto lambda = [job, ... args = std::forward<Args>(args), promise]() mutable {
-            if constexpr(std::is_void_v<ReturnValue>) {
-               job(args...);
-               promise->set_value();
+      /// @brief Finds this process's cgroups through /proc/self/cgroup and returns the tightest CPU quota of either cgroup version, rounded up to whole CPUs.
+      [[nodiscard]] inline std::optional<std::size_t> cgroupCpuLimit() {
+         std::ifstream              cgroups{ "/proc/self/cgroup" };
+         std::optional<std::size_t> limit;
+         std::string                line;
+         while(std::getline(cgroups, line)) {
+            // Each line is "<hierarchy id>:<controllers>:<path>", controllers are empty for the unified v2 hierarchy.
+            auto first  = line.find(':');
+            auto second = line.find(':', first + 1);
+            if(first == std::string::npos || second == std::string::npos) {
+               continue;
             }
-            else {
-               promise->set_value(job(std::forward<Args>(args)...));
+            std::string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+            std::string path        = line.substr(second + 1);
+
+            std::optional<std::size_t> found;
+            if(controllers == ",,") {
+               found = tightestCgroupCpuLimit("/sys/fs/cgroup", path, readCgroupV2CpuLimit);
             }
-            delete promise;
-         };
-         submit(lambda);
-         return future;
+            else if(controllers.find(",cpu,") != std::string::npos) {
+               found = tightestCgroupCpuLimit("/sys/fs/cgroup/cpu,cpuacct", path, readCgroupV1CpuLimit);
+               if(!found) {
+                  found = tightestCgroupCpuLimit("/sys/fs/cgroup/cpu", path, readCgroupV1CpuLimit);
+               }
+            }
+
+            if(found && (!limit || *found < *limit)) {
+               limit = found;
+            }
+         }
+         return limit;
       }
 
-      /// @brief Specialization of @see submitForReturn. Uses void as the return value, but unlike @see submit, this function allows that caller to wait for completion.
-      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-      /// @tparam Args [Optional] Arguments to provide to the job.
-      /// @param job The job to execute.
-      /// @param args Arguments to provide to the job.
-      /// @returns An std::future<void>. To wait for the job to finish use future.wait() or one of its alternate forms.
-      template<typename Job, typename... Args>
-      [[nodiscard]] inline std::future<void> submitWaitable(Job&& job, Args&&... args) {
-         return submitForReturn<void>(std::forward<Job>(job), std::forward<Args>(args)...);
+      /// @brief Returns @see cgroupCpuLimit as read on first use, or reads the cgroup files again and caches the new result if @paramref reread is true.
+      [[nodiscard]] inline std::optional<std::size_t> cachedCgroupCpuLimit(bool reread = false) {
+         // 0 until the files are first read, then the limit plus one, or the maximum for no limit.
+         static std::atomic_size_t cached{ 0 };
+         constexpr std::size_t     UNLIMITED = std::numeric_limits<std::size_t>::max();
+
+         std::size_t value = cached.load(std::memory_order_relaxed);
+         if(value == 0 || reread) {
+            auto limit = cgroupCpuLimit();
+            value      = limit ? *limit + 1 : UNLIMITED;
+            cached.store(value, std::memory_order_relaxed);
+         }
+         return value == UNLIMITED ? std::nullopt : std::optional<std::size_t>{ value - 1 };
       }
 
-      /// @brief Creates a job for each item in a container, passing the item as the only parameter to job.
-      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-      /// @tparam Container A container of some sort, must be support a for each loop.
-      /// @param job The job to execute.
-      /// @param container The container to iterate over.
-      /// @remarks This function blocks until each job created from each container item is complete. Do NOT modify the container during this call. The job's parameter can be a non-const lvalue
-      /// reference to modify each element, however, the owning container should never be modified during this call.
-      template<typename Job, typename Container>
-      inline void forEach(Job&& job, const Container& container) {
-         std::vector<std::future<void>> submittedJobs;
+      /// @brief Parses a sysfs CPU list such as "0-3,8,10-11" into the CPUs it names.
+      [[nodiscard]] inline std::vector<int> parseCpuList(const std::string& list) {
+         std::vector<int> cpus;
+         std::size_t      position = 0;
+         while(position < list.size()) {
+            std::size_t end   = list.find(',', position);
+            std::string range = list.substr(position, end == std::string::npos ? std::string::npos : end - position);
+            position          = end == std::string::npos ? list.size() : end + 1;
 
-         for(auto& item: container) {
-            submittedJobs.push_back(submitWaitable(job, item));
+            int first = 0;
+            int last  = 0;
+            try {
+               std::size_t dash = range.find('-');
+               first            = std::stoi(range);
+               last             = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            }
+            catch(const std::exception&) {
+               continue;
+            }
+            for(int cpu = first; cpu <= last; ++cpu) {
+               cpus.push_back(cpu);
+            }
          }
+         return cpus;
+      }
 
-         for(const auto& running: submittedJobs) {
-            running.wait();
+      /// @brief Returns the logical CPUs in this process's affinity mask, in ascending order.
+      [[nodiscard]] inline std::vector<int> affinityCpus() {
+         std::vector<int>  cpus;
+         const std::size_t cpuSetSize = std::max<std::size_t>(std::thread::hardware_concurrency(), CPU_SETSIZE);
+         cpu_set_t*        cpuSet     = CPU_ALLOC(cpuSetSize);
+         if(cpuSet == nullptr) {
+            return cpus;
          }
+         if(sched_getaffinity(0, CPU_ALLOC_SIZE(cpuSetSize), cpuSet) == 0) {
+            for(std::size_t cpu = 0; cpu < cpuSetSize; ++cpu) {
+               if(CPU_ISSET_S(cpu, CPU_ALLOC_SIZE(cpuSetSize), cpuSet)) {
+                  cpus.push_back(static_cast<int>(cpu));
+               }
+            }
+         }
+         CPU_FREE(cpuSet);
+         return cpus;
       }
 
-      /// @brief Creates N number of jobs where N is the number of times a number P can be incremented by @paramref increment from @paramref from to @paramref to.
-      /// @tparam Numeric A numeric value to increment from and to.
-      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-      /// @param job The job to execute, taking one parameter of type @see Numeric.
-      /// @param from The starting value to increment from (inclusive).
-      /// @param to The ending value to increment to (exclusive).
-      /// @param increment [Optional; Default=1] The value to increment by for each job.
-      /// @remarks This function blocks until all submitted jobs have completed. Do NOT modify an containers that may be backing the stored data. The job should take one parameter whose type is
-      /// @see Numeric.
-      template<typename Numeric, typename Job>
-      inline void forEachIndexed(Job&& job, Numeric from, Numeric to, Numeric increment = 1) requires(std::is_arithmetic_v<Numeric>) {
-         std::vector<std::future<void>> submittedJobs;
+      /// @brief Restricts the calling thread to @paramref cpus. Best effort; failures leave the thread's affinity unchanged.
+      inline void pinCurrentThread(const std::vector<int>& cpus) {
+         if(cpus.empty()) {
+            return;
+         }
+         const std::size_t cpuSetSize = static_cast<std::size_t>(*std::ranges::max_element(cpus)) + 1;
+         cpu_set_t*        cpuSet     = CPU_ALLOC(cpuSetSize);
+         if(cpuSet == nullptr) {
+            return;
+         }
+         CPU_ZERO_S(CPU_ALLOC_SIZE(cpuSetSize), cpuSet);
+         for(int cpu: cpus) {
+            CPU_SET_S(static_cast<std::size_t>(cpu), CPU_ALLOC_SIZE(cpuSetSize), cpuSet);
+         }
+         pthread_setaffinity_np(pthread_self(), CPU_ALLOC_SIZE(cpuSetSize), cpuSet);
+         CPU_FREE(cpuSet);
+      }
 
-         for(Numeric index = from; index < to; index += increment) {
-            submittedJobs.push_back(submitWaitable(job, index));
+      /// @brief Where a logical CPU sits in the machine. Each level is identified by the lowest numbered logical CPU it contains, except the NUMA node.
+      struct CpuLocation {
+         int cpu;
+         int core;   ///< Shared with the CPU's SMT siblings.
+         int llc;    ///< Shared with every CPU on the same last level cache, i.e. an L3 slice or an AMD CCX.
+         int node;   ///< The NUMA node.
+      };
+
+      /// @brief Reads the location of each CPU in @paramref cpus from sysfs under @paramref root. Levels sysfs does not describe fall back to the CPU itself for the core,
+      /// the whole machine for the last level cache and node 0.
+      [[nodiscard]] inline std::vector<CpuLocation> readCpuTopology(const std::vector<int>& cpus, const std::string& root = "/sys/devices/system") {
+         auto readLine = [](const std::string& path) {
+            std::ifstream file{ path };
+            std::string   line;
+            std::getline(file, line);
+            return line;
+         };
+         auto lowest = [](const std::vector<int>& list, int fallback) { return list.empty() ? fallback : *std::ranges::min_element(list); };
+
+         std::unordered_map<int, int> nodeOfCpu;
+         for(int node: parseCpuList(readLine(root + "/node/possible"))) {
+            for(int cpu: parseCpuList(readLine(root + "/node/node" + std::to_string(node) + "/cpulist"))) {
+               nodeOfCpu.emplace(cpu, node);
+            }
          }
 
-         for(const auto& running: submittedJobs) {
-            running.wait();
+         std::vector<CpuLocation> topology;
+         topology.reserve(cpus.size());
+         for(int cpu: cpus) {
+            std::string directory = root + "/cpu/cpu" + std::to_string(cpu);
+            CpuLocation location{ cpu, cpu, 0, 0 };
+            location.core = lowest(parseCpuList(readLine(directory + "/topology/thread_siblings_list")), cpu);
+
+            int highestLevel = 0;
+            for(int index = 0;; ++index) {
+               std::string cache = directory + "/cache/index" + std::to_string(index);
+               std::string level = readLine(cache + "/level");
+               if(level.empty()) {
+                  break;
+               }
+               if(readLine(cache + "/type") != "Instruction" && std::atoi(level.c_str()) > highestLevel) {
+                  highestLevel = std::atoi(level.c_str());
+                  location.llc = lowest(parseCpuList(readLine(cache + "/shared_cpu_list")), cpu);
+               }
+            }
+
+            if(auto node = nodeOfCpu.find(cpu); node != nodeOfCpu.end()) {
+               location.node = node->second;
+            }
+            topology.push_back(location);
          }
+         return topology;
       }
 
-      /// @brief Causes the caller to wait for all currently queued jobs to complete before continuing.
-      inline void finishAllJobs() { auto _ = finishAllJobsImpl(); }
+      /// @brief When set, pools built afterwards use this topology instead of reading the machine's. Not synchronized; only meant for tests.
+      [[nodiscard]] inline std::optional<std::vector<CpuLocation>>& topologyOverride() {
+         static std::optional<std::vector<CpuLocation>> topology;
+         return topology;
+      }
+   }   // namespace detail
+#endif
 
-      /// @brief Pauses the thread pools execution of queued jobs.
-      inline void pause() { auto _ = pauseImpl(); }
+   namespace detail {
+      /// @brief Implements @see defaultThreadCount, reading the cgroup quota again if @paramref rereadCgroups is true.
+      [[nodiscard]] inline std::size_t availableThreadCount([[maybe_unused]] bool rereadCgroups) {
+         std::size_t count = static_cast<std::size_t>(std::thread::hardware_concurrency());
+#if defined(__linux__)
+         const std::size_t cpuSetSize = std::max<std::size_t>(count, CPU_SETSIZE);
+         cpu_set_t*        cpuSet     = CPU_ALLOC(cpuSetSize);
+         if(cpuSet != nullptr) {
+            if(sched_getaffinity(0, CPU_ALLOC_SIZE(cpuSetSize), cpuSet) == 0) {
+               count = static_cast<std::size_t>(CPU_COUNT_S(CPU_ALLOC_SIZE(cpuSetSize), cpuSet));
+            }
+            CPU_FREE(cpuSet);
+         }
 
-      /// @brief Resumes the thread pools job execution.
-      inline void resume() { m_pause = false; }
+         if(auto limit = cachedCgroupCpuLimit(rereadCgroups)) {
+            count = std::min(count, *limit);
+         }
+#endif
+         return std::max<std::size_t>(count, 1);
+      }
+   }   // namespace detail
 
-      /// @brief Completes all jobs in the queue then joins all the threads.
-      inline void shutdown() { auto _ = shutdownImpl(); }
+   /// @brief Returns the number of CPUs this process can actually run on. On Linux this is the size of the affinity mask, capped by any cgroup v1 or v2 CPU quota rounded up
+   /// to whole CPUs, so a container limited to 4 CPUs on a 96 CPU host reports 4. Elsewhere it is std::thread::hardware_concurrency().
+   /// @remarks The affinity mask is read on every call, but the cgroup quota only on first use, as this is the default thread count of every pool. Use
+   /// @see refreshDefaultThreadCount to follow quota changes at runtime. Never returns less than 1.
+   [[nodiscard]] inline std::size_t defaultThreadCount() { return detail::availableThreadCount(false); }
 
-      /// @brief Completes all jobs in the queue, joins all the threads, then starts up a set number of threads.
-      /// @param newThreadCount The number of threads to create in the pool.
-      inline void reset(std::size_t newThreadCount = std::thread::hardware_concurrency()) {
-         auto lock     = shutdownImpl();
-         m_threadCount = newThreadCount;
-         init();
-      }
+   /// @brief Like @see defaultThreadCount, but reads the cgroup quota again, updating the value later calls to @see defaultThreadCount use.
+   [[nodiscard]] inline std::size_t refreshDefaultThreadCount() { return detail::availableThreadCount(true); }
 
-      /// @brief Pauses execution of the thread pool, waiting for all in-flight jobs to finish but retaining whats still in the queue. Joins all the threads then spins
-      /// up new ones before resuming execution.
-      /// @param newThreadCount The number of threads in the thread pool.
-      /// @remarks If newThreadCount is 0, this is equivalent to calling shutdown.
-      inline void setThreadCount(std::size_t newThreadCount) {
-         if(newThreadCount == 0) {
-            shutdown();
-            return;
+#if defined(__linux__)
+   /// @brief Returns the CPUs isolated from the scheduler with isolcpus, as listed in /sys/devices/system/cpu/isolated. These are the CPUs to give
+   /// @see TnTThreadPool::addLowLatencyWorker.
+   [[nodiscard]] inline std::vector<int> isolatedCpus() {
+      std::ifstream file{ "/sys/devices/system/cpu/isolated" };
+      std::string   list;
+      std::getline(file, list);
+      return detail::parseCpuList(list);
+   }
+#endif
+
+#if defined(__linux__)
+   /// @brief The Linux scheduling policies a @see TnTThreadPool can run its threads under.
+   enum class SchedulingPolicy {
+      /// SCHED_OTHER, the default time-sharing policy, weighted by the nice value.
+      Other,
+      /// SCHED_BATCH, time-sharing for CPU-bound work that is never preferred on wake-up.
+      Batch,
+      /// SCHED_IDLE, only runs when nothing else wants the CPU.
+      Idle,
+      /// SCHED_FIFO, real-time, runs until it blocks or yields. Usually requires CAP_SYS_NICE.
+      Fifo
+   };
+
+   /// @brief Scheduling applied by each thread of a @see TnTThreadPool as it starts.
+   struct WorkerScheduling {
+      SchedulingPolicy policy   = SchedulingPolicy::Other;
+      int              nice     = 0;   ///< Used by Other and Batch, from -20 (favoured) to 19. Negative values usually require CAP_SYS_NICE.
+      int              priority = 0;   ///< Used by Fifo, from 1 to 99.
+   };
+
+   namespace detail {
+      /// @brief Applies @paramref scheduling to the calling thread. Linux nice values are per thread, so this does not affect the rest of the process.
+      /// @returns 0 on success, otherwise the error of the call that failed.
+      [[nodiscard]] inline int applyScheduling(const WorkerScheduling& scheduling) {
+         int policy = SCHED_OTHER;
+         switch(scheduling.policy) {
+            case SchedulingPolicy::Other: policy = SCHED_OTHER; break;
+            case SchedulingPolicy::Batch: policy = SCHED_BATCH; break;
+            case SchedulingPolicy::Idle: policy = SCHED_IDLE; break;
+            case SchedulingPolicy::Fifo: policy = SCHED_FIFO; break;
          }
-         else { 
-            m_threadCount = newThreadCount;
-            auto lock = pauseImpl();
-            m_execute = false;
-            lock.unlock();
-            joinThreadsImpl();
-            lock.lock();
-            init();
-            resume();
+
+         sched_param parameters{};
+         parameters.sched_priority = policy == SCHED_FIFO ? scheduling.priority : 0;
+         if(int error = pthread_setschedparam(pthread_self(), policy, &parameters); error != 0) {
+            return error;
+         }
+         if(policy == SCHED_OTHER || policy == SCHED_BATCH) {
+            if(setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), scheduling.nice) != 0) {
+               return errno;
+            }
          }
+         return 0;
       }
+   }   // namespace detail
+#endif
 
-      /// @brief Returns the number of threads in the pool.
-      [[nodiscard]] inline std::size_t getThreadCount() {
-         std::scoped_lock lock{ m_jobQueueMutex };
-         return m_threads.size();
+   /// @brief Process-wide CPU token arbiter shared by any number of @see TnTThreadPool instances. A worker holds one token while it is running jobs and hands it back as soon
+   /// as its queue runs dry, so the workers of all the pools sharing a budget never run more than @see capacity jobs at once and an idle pool lends its share to busy ones.
+   /// While another worker is waiting for a token, a worker also hands its token back every @see TnTThreadPool::CPU_TOKEN_QUANTUM jobs, so a pool with a deep queue cannot
+   /// starve the others sharing the budget.
+   /// @remarks The budget must outlive every pool attached to it. Use @see global for a budget sized to the CPUs available to the process.
+   class CpuBudget {
+     public:
+      /// @param tokens [Optional; Default=defaultThreadCount()] The number of jobs the attached pools may run concurrently, must be at least 1.
+      explicit CpuBudget(std::size_t tokens = defaultThreadCount()) : m_capacity(std::max<std::size_t>(tokens, 1)), m_tokens(static_cast<std::ptrdiff_t>(m_capacity)) {}
+
+      CpuBudget(const CpuBudget&)            = delete;
+      CpuBudget& operator=(const CpuBudget&) = delete;
+
+      /// @brief Returns the budget shared by the whole process, sized with @see defaultThreadCount on first use.
+      /// @remarks The instance is never destroyed so pools with static storage duration may still use it while the program exits.
+      [[nodiscard]] static inline CpuBudget& global() {
+         static CpuBudget* budget = new CpuBudget();
+         return *budget;
+      }
+
+      /// @brief Takes a token, waiting up to @paramref timeout for one to be returned.
+      /// @returns False if no token became available in time.
+      template<typename Rep, typename Period>
+      [[nodiscard]] inline bool tryAcquireFor(const std::chrono::duration<Rep, Period>& timeout) {
+         m_waiters.fetch_add(1, std::memory_order_relaxed);
+         bool acquired = m_tokens.try_acquire_for(timeout);
+         m_waiters.fetch_sub(1, std::memory_order_relaxed);
+         return acquired;
+      }
+
+      /// @brief Takes a token, waiting for as long as it takes.
+      inline void acquire() {
+         m_waiters.fetch_add(1, std::memory_order_relaxed);
+         m_tokens.acquire();
+         m_waiters.fetch_sub(1, std::memory_order_relaxed);
       }
 
+      /// @brief Returns a token taken with @see tryAcquireFor or @see acquire.
+      inline void release() { m_tokens.release(); }
+
+      /// @brief Returns the number of tokens the budget was created with.
+      [[nodiscard]] inline std::size_t capacity() const noexcept { return m_capacity; }
+
+      /// @returns True if some thread is currently waiting in @see tryAcquireFor or @see acquire.
+      [[nodiscard]] inline bool contended() const noexcept { return m_waiters.load(std::memory_order_relaxed) != 0; }
+
      private:
-      inline void init() {
-         m_execute = true;
-         for(std::size_t i = 0; i < m_threadCount; ++i) {
-            m_threads.emplace_back(std::bind(&TnTThreadPool::executor, this));
+      std::size_t               m_capacity;
+      std::counting_semaphore<> m_tokens;
+      std::atomic_size_t        m_waiters{ 0 };
+   };
+
+   /// @brief Default for the ReturnValue of @see TnTThreadPool::submitForReturn, requesting that the return type be deduced from the job.
+   struct DeduceReturnValue {};
+
+   namespace detail {
+      /// @brief A queued job that either a worker or a thread waiting on its result may run, whichever claims it first.
+      struct ClaimableJob {
+         virtual ~ClaimableJob() = default;
+
+         /// @returns True if this call claimed and ran the job, false if it was already claimed.
+         inline bool tryRun() {
+            if(claimed.exchange(true, std::memory_order_acq_rel)) {
+               return false;
+            }
+            run();
+            return true;
          }
+
+         virtual void run() noexcept = 0;
+
+         std::atomic_bool claimed{ false };
+      };
+   }
+
+   /// @brief The future returned by @see TnTThreadPool::submitForReturnClaimable. Waiting on it with get() or wait() while the job is still queued claims the job and
+   /// runs it on the waiting thread, instead of blocking until a worker gets to it. The worker then finds the job claimed and skips it.
+   /// @tparam T The return value of the job.
+   template<typename T>
+   class ClaimableFuture {
+     public:
+      ClaimableFuture() = default;
+
+      /// @returns True if the future refers to a result, i.e. it came from a submission and get() has not been called yet.
+      [[nodiscard]] inline bool valid() const noexcept { return m_future.valid(); }
+
+      /// @brief Runs the job on this thread if no worker has started it yet, then returns its result. Exceptions thrown by the job are rethrown.
+      inline T get() {
+         runIfPending();
+         m_job.reset();
+         return m_future.get();
       }
 
-      inline void executor() {
-         std::function<void()> currentJob;
-         while(m_execute) {
-            {
-               std::scoped_lock lock{ m_jobQueueMutex };
-               if(m_queuedTasks == 0 || m_pause) {
-                  m_cv.notify_all();
-                  std::this_thread::yield();
-               }
-               else {
-                  ++m_runningTasks;
-                  currentJob.swap(m_jobQueue.front());
-                  m_jobQueue.pop();
-                  --m_queuedTasks;
-               }
+      /// @brief Runs the job on this thread if no worker has started it yet, otherwise waits for the worker to finish it.
+      inline void wait() const {
+         runIfPending();
+         m_future.wait();
+      }
+
+      /// @brief Waits like std::future::wait_for. Never runs the job inline, as it could take longer than the timeout.
+      template<typename Rep, typename Period>
+      [[nodiscard]] inline std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+         return m_future.wait_for(timeout);
+      }
+
+      /// @brief Waits like std::future::wait_until. Never runs the job inline, as it could take longer than the timeout.
+      template<typename Clock, typename Duration>
+      [[nodiscard]] inline std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& deadline) const {
+         return m_future.wait_until(deadline);
+      }
+
+      /// @brief Runs the job on this thread if no worker has started it yet, without waiting otherwise.
+      /// @returns True if the job ran on this thread.
+      inline bool runIfPending() const { return m_job && m_job->tryRun(); }
+
+     private:
+      friend class TnTThreadPool;
+
+      ClaimableFuture(std::future<T> future, std::shared_ptr<detail::ClaimableJob> job) : m_future(std::move(future)), m_job(std::move(job)) {}
+
+      std::future<T>                        m_future;
+      std::shared_ptr<detail::ClaimableJob> m_job;
+   };
+
+   /// @brief Move-only, type-erased void() callable that the pool queues. Callables up to @see INLINE_SIZE bytes are stored inside the task itself, larger ones are allocated
+   /// from the memory resource the task was created with.
+   class Task {
+     public:
+      static constexpr std::size_t INLINE_SIZE = 48;
+
+      Task() = default;
+
+      template<typename Callable>
+      requires(!std::is_same_v<std::decay_t<Callable>, Task> && std::is_invocable_v<std::decay_t<Callable>&>)
+      Task(Callable&& callable, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource()) : m_memoryResource(memoryResource) {
+         using Stored = std::decay_t<Callable>;
+         if constexpr(isStoredInline<Stored>()) {
+            ::new(static_cast<void*>(m_storage)) Stored(std::forward<Callable>(callable));
+            m_operations = &INLINE_OPERATIONS<Stored>;
+         }
+         else {
+            void* object = m_memoryResource->allocate(sizeof(Stored), alignof(Stored));
+            try {
+               ::new(object) Stored(std::forward<Callable>(callable));
             }
-            if(currentJob) {
-               currentJob();
-               currentJob = {};
-               --m_runningTasks;
+            catch(...) {
+               m_memoryResource->deallocate(object, sizeof(Stored), alignof(Stored));
+               throw;
             }
+            ::new(static_cast<void*>(m_storage)) void*(object);
+            m_operations = &HEAP_OPERATIONS<Stored>;
          }
       }
 
-      template<typename Job>
-      inline void queueJob(Job&& job) {
-         std::scoped_lock lock{ m_jobQueueMutex };
-         if (m_threads.empty()) {
-            throw std::runtime_error("Attempted to queue a job, but the thread pool was shutdown. Call reset before queuing jobs.");
+      Task(Task&& other) noexcept { moveFrom(other); }
+
+      Task& operator=(Task&& other) noexcept {
+         if(this != &other) {
+            reset();
+            moveFrom(other);
          }
-         
-         ++m_queuedTasks;
-         m_jobQueue.emplace(std::forward<Job>(job));
+         return *this;
       }
 
-      inline void joinThreadsImpl() { m_threads.clear(); }
+      Task(const Task&)            = delete;
+      Task& operator=(const Task&) = delete;
 
-      [[nodiscard]] inline std::unique_lock<std::mutex> finishAllJobsImpl() {
-         m_execute = true;
-         std::unique_lock lock{ m_jobQueueMutex };
-         m_cv.wait(lock, [this] { return m_runningTasks == 0 && m_queuedTasks == 0; });
-         return lock;
+      ~Task() { reset(); }
+
+      inline void operator()() { m_operations->invoke(m_storage); }
+
+      explicit operator bool() const noexcept { return m_operations != nullptr; }
+
+      /// @brief Destroys the stored callable, returning any memory it used to its memory resource.
+      inline void reset() noexcept {
+         if(m_operations != nullptr) {
+            m_operations->destroy(m_storage, m_memoryResource);
+            m_operations = nullptr;
+         }
       }
 
-      [[nodiscard]] inline std::unique_lock<std::mutex> shutdownImpl() {
-         m_execute = true;
-         m_pause   = false;
-         auto lock = finishAllJobsImpl();
-         m_execute = false;
-         lock.unlock();
-         joinThreadsImpl();
-         lock.lock();
-         return lock;
+     private:
+      struct Operations {
+         void (*invoke)(std::byte*);
+         void (*relocate)(std::byte*, std::byte*) noexcept;
+         void (*destroy)(std::byte*, std::pmr::memory_resource*) noexcept;
+      };
+
+      template<typename Stored>
+      [[nodiscard]] static consteval bool isStoredInline() {
+         return sizeof(Stored) <= INLINE_SIZE && alignof(Stored) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Stored>;
       }
 
-      inline void cleanUp() { auto _ = shutdownImpl(); }
+      template<typename Stored>
+      [[nodiscard]] static inline Stored* inlineObject(std::byte* storage) noexcept {
+         return std::launder(reinterpret_cast<Stored*>(storage));
+      }
 
-      [[nodiscard]] inline std::unique_lock<std::mutex> pauseImpl() {
-         m_pause = true;
-         std::unique_lock lock{ m_jobQueueMutex };
-         m_cv.wait(lock, [this] { return m_runningTasks == 0; });
-         return lock;
+      template<typename Stored>
+      [[nodiscard]] static inline Stored* heapObject(std::byte* storage) noexcept {
+         return static_cast<Stored*>(*std::launder(reinterpret_cast<void**>(storage)));
+      }
+
+      template<typename Stored>
+      static constexpr Operations INLINE_OPERATIONS{ [](std::byte* storage) { (*inlineObject<Stored>(storage))(); },
+                                                     [](std::byte* from, std::byte* to) noexcept {
+                                                        Stored* source = inlineObject<Stored>(from);
+                                                        ::new(static_cast<void*>(to)) Stored(std::move(*source));
+                                                        source->~Stored();
+                                                     },
+                                                     [](std::byte* storage, std::pmr::memory_resource*) noexcept { inlineObject<Stored>(storage)->~Stored(); } };
+
+      template<typename Stored>
+      static constexpr Operations HEAP_OPERATIONS{ [](std::byte* storage) { (*heapObject<Stored>(storage))(); },
+                                                   [](std::byte* from, std::byte* to) noexcept { ::new(static_cast<void*>(to)) void*(heapObject<Stored>(from)); },
+                                                   [](std::byte* storage, std::pmr::memory_resource* memoryResource) noexcept {
+                                                      Stored* object = heapObject<Stored>(storage);
+                                                      object->~Stored();
+                                                      memoryResource->deallocate(object, sizeof(Stored), alignof(Stored));
+                                                   } };
+
+      inline void moveFrom(Task& other) noexcept {
+         if(other.m_operations != nullptr) {
+            other.m_operations->relocate(other.m_storage, m_storage);
+            m_operations     = std::exchange(other.m_operations, nullptr);
+            m_memoryResource = other.m_memoryResource;
+         }
       }
 
      private:
-      std::mutex                        m_jobQueueMutex;
-      std::vector<std::jthread>         m_threads;
-      std::queue<std::function<void()>> m_jobQueue;
+      alignas(std::max_align_t) std::byte m_storage[INLINE_SIZE];
+      const Operations*                   m_operations{ nullptr };
+      std::pmr::memory_resource*          m_memoryResource{ nullptr };
+   };
 
-      std::atomic_bool   m_execute{ true };
-      std::atomic_bool   m_pause{ false };
-      std::atomic_size_t m_runningTasks{ 0 };
-      std::atomic_size_t m_queuedTasks{ 0 };
+   /// @brief Controls how a @see TnTThreadPool starts its threads.
+   struct ThreadOptions {
+      /// Stack size in bytes for each worker, spare and blocking thread and the flushing thread of a @see MicroBatcher, or 0 for the platform default (usually 8 MB on
+      /// Linux). Only honoured on POSIX platforms.
+      std::size_t stackSize = 0;
+      /// If true, workers are started one at a time as queued work appears and finds no idle worker, up to the thread count, instead of all up front.
+      bool lazyStart = false;
+      /// If true, the constructing thread only starts the first worker and every worker starts up to two more, so a large pool starts in logarithmic rather than linear time.
+      bool treeStart = false;
+      /// Bytes of stack each worker touches before it takes a job, so its first jobs do not page-fault the stack in. Must be well below the stack size.
+      std::size_t prefaultStack = 0;
+      /// Run by each worker, with its index, before it takes a job. I.e. to touch thread local or NUMA local data.
+      std::function<void(std::size_t)> warmUp{};
+   };
 
-      std::size_t m_threadCount;
+   /// @brief Controls how many workers a @see TnTThreadPool starts and which CPUs they are pinned to.
+   enum class WorkerPlacement {
+      /// The thread count is given by the caller and workers are not pinned. Each worker still takes jobs from the queue of its last level cache first.
+      Default,
+      /// @see defaultThreadCount workers, each pinned to the CPUs of the last level cache whose queue it serves.
+      LastLevelCaches,
+      /// One worker per logical CPU, each pinned to its own CPU.
+      LogicalCpus,
+      /// One worker per physical core, each pinned to the SMT siblings of its core so no two workers share a core.
+      PhysicalCores
+   };
 
-      std::condition_variable m_cv;
+   /// @brief Controls whether a @see RingBuffer hands memory back as it drains.
+   enum class ShrinkPolicy {
+      /// Capacity is only released on destruction or an explicit shrinkToFit.
+      Retain,
+      /// Capacity is halved whenever the buffer drops to a quarter full, never below the minimum capacity.
+      HalveWhenQuarterFull
    };
 
-   /// @brief Creates a job for each item in a container, passing the item as the only parameter to job.
-   /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-   /// @tparam Container A container of some sort, must be support a for each loop.
-   /// @param job The job to execute.
-   /// @param container The container to iterate over.
-   /// @remarks This function blocks until each job created from each container item is complete. Do NOT modify the container during this call. The job's parameter can be a non-const lvalue
-   /// reference to modify each element, however, the owning container should never be modified during this call.
-   template<typename Job, typename Container>
-   static inline void forEach(Job&& job, const Container& container, std::size_t threadCount = static_cast<std::size_t>(std::thread::hardware_concurrency())) {
-      TnTThreadPool threadPool{ threadCount };
-      threadPool.forEach(std::forward(job), container);
-   }
+   /// @brief Growable FIFO kept in a single contiguous, power of two sized buffer. Unlike std::deque it keeps its capacity as it drains, so a queue whose depth swings
+   /// between empty and very deep stops going back to the allocator once it has grown to its high water mark.
+   /// @tparam T The element type, must be nothrow move constructible.
+   template<typename T>
+   class RingBuffer {
+      static_assert(std::is_nothrow_move_constructible_v<T>, "RingBuffer relocates elements when it grows and requires a noexcept move constructor.");
 
-   /// @brief Creates N number of jobs where N is the number of times a number P can be incremented by @paramref increment from @paramref from to @paramref to.
-   /// @tparam Numeric A numeric value to increment from and to.
-   /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
-   /// @param job The job to execute, taking one parameter of type @see Numeric.
-   /// @param from The starting value to increment from (inclusive).
-   /// @param to The ending value to increment to (exclusive).
-   /// @param increment [Optional; Default=1] The value to increment by for each job.
-   /// @remarks This function blocks until all submitted jobs have completed. Do NOT modify an containers that may be backing the stored data. The job should take one parameter whose type is
-   /// @see Numeric.
-   template<typename Numeric, typename Job>
-   static inline void forEachIndexed(Job&&       job,
-                                     Numeric     from,
-                                     Numeric     to,
+     public:
+      static constexpr std::size_t MINIMUM_CAPACITY = 64;
+
+      explicit RingBuffer(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource()) : m_allocator(memoryResource) {}
+
+      RingBuffer(const RingBuffer&)            = delete;
+      RingBuffer& operator=(const RingBuffer&) = delete;
+
+      ~RingBuffer() {
+         while(!empty()) {
+            std::destroy_at(&front());
+            m_head = (m_head + 1) & (m_capacity - 1);
+            --m_size;
+         }
+         if(m_buffer != nullptr) {
+            m_allocator.deallocate(m_buffer, m_capacity);
+         }
+      }
+
+      /// @brief Constructs an element at the back, doubling the capacity first if the buffer is full.
+      template<typename... Args>
+      inline T& emplace(Args&&... args) {
+         if(m_size == m_capacity) {
+            reallocate(m_capacity == 0 ? MINIMUM_CAPACITY : m_capacity * 2);
+         }
+         T* slot = std::construct_at(m_buffer + ((m_head + m_size) & (m_capacity - 1)), std::forward<Args>(args)...);
+         ++m_size;
+         return *slot;
+      }
+
+      [[nodiscard]] inline T& front() { return m_buffer[m_head]; }
+
+      /// @brief Destroys the front element. May release memory according to the shrink policy.
+      inline void pop() {
+         std::destroy_at(&front());
+         m_head = (m_head + 1) & (m_capacity - 1);
+         --m_size;
+         if(m_shrinkPolicy == ShrinkPolicy::HalveWhenQuarterFull && m_capacity > MINIMUM_CAPACITY && m_size <= m_capacity / 4) {
+            reallocate(m_capacity / 2);
+         }
+      }
+
+      [[nodiscard]] inline std::size_t size() const noexcept { return m_size; }
+      [[nodiscard]] inline bool        empty() const noexcept { return m_size == 0; }
+      [[nodiscard]] inline std::size_t capacity() const noexcept { return m_capacity; }
+
+      /// @brief Grows the buffer so at least @paramref capacity elements fit without further allocation.
+      inline void reserve(std::size_t capacity) {
+         if(capacity > m_capacity) {
+            reallocate(std::bit_ceil(std::max(capacity, MINIMUM_CAPACITY)));
+         }
+      }
+
+      /// @brief Releases capacity down to the smallest power of two that holds the current elements.
+      inline void shrinkToFit() {
+         std::size_t fitted = std::bit_ceil(std::max(m_size, MINIMUM_CAPACITY));
+         if(fitted < m_capacity) {
+            reallocate(fitted);
+         }
+      }
+
+      inline void setShrinkPolicy(ShrinkPolicy shrinkPolicy) noexcept { m_shrinkPolicy = shrinkPolicy; }
+
+     private:
+      inline void reallocate(std::size_t newCapacity) {
+         T* newBuffer = m_allocator.allocate(newCapacity);
+         for(std::size_t i = 0; i < m_size; ++i) {
+            T* source = m_buffer + ((m_head + i) & (m_capacity - 1));
+            std::construct_at(newBuffer + i, std::move(*source));
+            std::destroy_at(source);
+         }
+         if(m_buffer != nullptr) {
+            m_allocator.deallocate(m_buffer, m_capacity);
+         }
+         m_buffer   = newBuffer;
+         m_capacity = newCapacity;
+         m_head     = 0;
+      }
+
+     private:
+      std::pmr::polymorphic_allocator<T> m_allocator;
+      T*                                 m_buffer{ nullptr };
+      std::size_t                        m_capacity{ 0 };
+      std::size_t                        m_head{ 0 };
+      std::size_t                        m_size{ 0 };
+      ShrinkPolicy                       m_shrinkPolicy{ ShrinkPolicy::Retain };
+   };
+
+   namespace detail {
+      /// @brief Tells the CPU the caller is spinning: the pause instruction on x86, yield on ARM, otherwise a yield to the scheduler.
+      inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+         _mm_pause();
+#elif(defined(__aarch64__) || defined(__arm__)) && (defined(__GNUC__) || defined(__clang__))
+         __asm__ __volatile__("yield");
+#else
+         std::this_thread::yield();
+#endif
+      }
+
+      /// @brief Bounded lock-free queue for many producers and a single consumer. Each cell carries a sequence number that tells producers and the consumer whose turn it
+      /// is, so neither side takes a lock and the consumer never writes to a cache line the producers contend on except the cell it just emptied.
+      /// @tparam T A default constructible, move assignable type.
+      template<typename T>
+      class MpscRing {
+        public:
+         /// @param capacity The number of elements the queue holds, rounded up to a power of two.
+         explicit MpscRing(std::size_t capacity) : m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1), m_cells(std::make_unique<Cell[]>(m_mask + 1)) {
+            for(std::size_t i = 0; i <= m_mask; ++i) {
+               m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+         }
+
+         /// @brief Constructs an element at the back of the queue. Safe to call from any number of threads.
+         /// @returns False if the queue is full.
+         template<typename... Args>
+         [[nodiscard]] inline bool tryEmplace(Args&&... args) {
+            std::size_t position = m_head.load(std::memory_order_relaxed);
+            Cell*       cell     = nullptr;
+            while(true) {
+               cell                      = &m_cells[position & m_mask];
+               std::size_t    sequence   = cell->sequence.load(std::memory_order_acquire);
+               std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+               if(difference == 0) {
+                  if(m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                     break;
+                  }
+               }
+               else if(difference < 0) {
+                  return false;
+               }
+               else {
+                  position = m_head.load(std::memory_order_relaxed);
+               }
+            }
+            cell->value = T(std::forward<Args>(args)...);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+         }
+
+         /// @brief Moves the front element into @paramref out. Must only be called from the single consumer thread.
+         /// @returns False if the queue is empty.
+         [[nodiscard]] inline bool tryPop(T& out) {
+            Cell& cell = m_cells[m_tail & m_mask];
+            if(cell.sequence.load(std::memory_order_acquire) != m_tail + 1) {
+               return false;
+            }
+            out = std::move(cell.value);
+            cell.value = T();
+            cell.sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+            ++m_tail;
+            return true;
+         }
+
+        private:
+         struct Cell {
+            std::atomic_size_t sequence{ 0 };
+            T                  value{};
+         };
+
+         static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+         std::size_t                                m_mask;
+         std::unique_ptr<Cell[]>                    m_cells;
+         alignas(CACHE_LINE_SIZE) std::atomic_size_t m_head{ 0 };
+         alignas(CACHE_LINE_SIZE) std::size_t        m_tail{ 0 };
+      };
+
+      /// @brief Touches the next @paramref bytes of the calling thread's stack one page at a time, so that later calls do not page-fault it in.
+      [[gnu::noinline]] inline void prefaultStack(std::size_t bytes) {
+#if defined(TNT_HAS_PTHREAD)
+         const auto          pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+         volatile std::byte* stack    = static_cast<volatile std::byte*>(alloca(bytes));
+         for(std::size_t offset = 0; offset < bytes; offset += pageSize) {
+            stack[offset] = std::byte{ 0 };
+         }
+#else
+         static_cast<void>(bytes);
+#endif
+      }
+
+      /// @brief A thread that joins on destruction like std::jthread, but can be given a stack size. POSIX threads get it through pthread attributes, elsewhere the size
+      /// is ignored and the platform default is used.
+      class Thread {
+        public:
+         Thread() = default;
+
+         /// @param stackSize The stack size in bytes, or 0 for the platform default. Raised to the platform minimum if smaller.
+         /// @param function The callable to run on the new thread.
+         /// @throws std::system_error If the thread could not be started.
+         template<typename Function>
+         Thread(std::size_t stackSize, Function&& function) {
+#if defined(TNT_HAS_PTHREAD)
+            using State = std::decay_t<Function>;
+            auto state  = std::make_unique<State>(std::forward<Function>(function));
+
+            pthread_attr_t attributes;
+            pthread_attr_init(&attributes);
+            if(stackSize != 0) {
+               pthread_attr_setstacksize(&attributes, std::max(stackSize, static_cast<std::size_t>(PTHREAD_STACK_MIN)));
+            }
+            int error = pthread_create(&m_handle, &attributes, &Thread::run<State>, state.get());
+            pthread_attr_destroy(&attributes);
+            if(error != 0) {
+               throw std::system_error(error, std::system_category(), "Failed to start thread");
+            }
+            state.release();
+            m_joinable = true;
+#else
+            static_cast<void>(stackSize);
+            m_thread = std::thread{ std::forward<Function>(function) };
+#endif
+         }
+
+         Thread(Thread&& other) noexcept { *this = std::move(other); }
+
+         Thread& operator=(Thread&& other) noexcept {
+            if(this != &other) {
+               join();
+#if defined(TNT_HAS_PTHREAD)
+               m_handle         = other.m_handle;
+               m_joinable       = std::exchange(other.m_joinable, false);
+#else
+               m_thread = std::move(other.m_thread);
+#endif
+            }
+            return *this;
+         }
+
+         ~Thread() { join(); }
+
+         [[nodiscard]] inline bool joinable() const noexcept {
+#if defined(TNT_HAS_PTHREAD)
+            return m_joinable;
+#else
+            return m_thread.joinable();
+#endif
+         }
+
+         /// @brief Waits for the thread to finish. Does nothing if there is no thread or it was already joined.
+         inline void join() noexcept {
+#if defined(TNT_HAS_PTHREAD)
+            if(std::exchange(m_joinable, false)) {
+               pthread_join(m_handle, nullptr);
+            }
+#else
+            if(m_thread.joinable()) {
+               m_thread.join();
+            }
+#endif
+         }
+
+        private:
+#if defined(TNT_HAS_PTHREAD)
+         template<typename State>
+         static void* run(void* state) {
+            std::unique_ptr<State> function{ static_cast<State*>(state) };
+            (*function)();
+            return nullptr;
+         }
+
+         pthread_t m_handle{};
+         bool      m_joinable{ false };
+#else
+         std::thread m_thread;
+#endif
+      };
+   }   // namespace detail
+
+#if defined(TNT_HAS_EPOLL)
+   /// @brief epoll instance owned by a @see TnTThreadPool. Idle workers take turns leading: whichever worker wins @see tryLead waits on epoll, hands leadership back, queues
+   /// all but the first ready callback as jobs and runs the first one itself, so the common case of a single ready fd needs no cross-thread handoff.
+   /// @remarks File descriptors are registered one-shot and re-armed after their callback returns, so a callback never runs concurrently with itself.
+   class Reactor {
+     public:
+      using Callback = std::function<void(std::uint32_t)>;
+
+      static constexpr std::size_t MAX_EVENTS = 64;
+      using Events                            = std::array<epoll_event, MAX_EVENTS>;
+
+      Reactor() : m_epollFd(epoll_create1(EPOLL_CLOEXEC)) {
+         if(m_epollFd < 0) {
+            throw std::system_error(errno, std::system_category(), "epoll_create1 failed");
+         }
+      }
+
+      Reactor(const Reactor&)            = delete;
+      Reactor& operator=(const Reactor&) = delete;
+
+      ~Reactor() { close(m_epollFd); }
+
+      inline void add(int fd, std::uint32_t events, Callback callback) {
+         std::scoped_lock lock{ m_registrationMutex };
+         auto             registration = std::make_shared<Registration>(Registration{ std::move(callback), events });
+         control(EPOLL_CTL_ADD, fd, events);
+         m_registrations.insert_or_assign(fd, std::move(registration));
+      }
+
+      inline void modify(int fd, std::uint32_t events) {
+         std::scoped_lock lock{ m_registrationMutex };
+         auto             found = m_registrations.find(fd);
+         if(found == m_registrations.end()) {
+            throw std::runtime_error("Attempted to modify a file descriptor that is not registered with the reactor.");
+         }
+         found->second->events = events;
+         control(EPOLL_CTL_MOD, fd, events);
+      }
+
+      inline void remove(int fd) {
+         std::scoped_lock lock{ m_registrationMutex };
+         if(m_registrations.erase(fd) > 0) {
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+         }
+      }
+
+      /// @brief Attempts to become the worker that waits on epoll. Only one worker leads at a time.
+      [[nodiscard]] inline bool tryLead() { return !m_leading.exchange(true, std::memory_order_acquire); }
+
+      /// @brief Waits for readiness then gives up leadership so another idle worker can wait while this one dispatches.
+      /// @returns The number of ready entries written to @paramref events.
+      [[nodiscard]] inline std::size_t wait(Events& events, int timeoutMs) {
+         int ready = epoll_wait(m_epollFd, events.data(), static_cast<int>(events.size()), timeoutMs);
+         m_leading.store(false, std::memory_order_release);
+         return ready > 0 ? static_cast<std::size_t>(ready) : 0;
+      }
+
+      /// @brief Runs the callback registered for @paramref fd, then re-arms it if it is still registered. A callback that closed its file descriptor without
+      /// unregistering it is unregistered here, as the descriptor can no longer be re-armed.
+      inline void dispatch(int fd, std::uint32_t readyEvents) {
+         std::shared_ptr<Registration> registration;
+         {
+            std::scoped_lock lock{ m_registrationMutex };
+            auto             found = m_registrations.find(fd);
+            if(found == m_registrations.end()) {
+               return;
+            }
+            registration = found->second;
+         }
+
+         registration->callback(readyEvents);
+
+         std::scoped_lock lock{ m_registrationMutex };
+         auto             found = m_registrations.find(fd);
+         if(found != m_registrations.end() && found->second == registration) {
+            if(int error = tryControl(EPOLL_CTL_MOD, fd, registration->events); error == EBADF || error == ENOENT) {
+               m_registrations.erase(found);
+            }
+            else if(error != 0) {
+               throw std::system_error(error, std::system_category(), "epoll_ctl failed");
+            }
+         }
+      }
+
+     private:
+      struct Registration {
+         Callback      callback;
+         std::uint32_t events;
+      };
+
+      inline void control(int operation, int fd, std::uint32_t events) {
+         if(int error = tryControl(operation, fd, events); error != 0) {
+            throw std::system_error(error, std::system_category(), "epoll_ctl failed");
+         }
+      }
+
+      /// @returns 0 on success, otherwise the errno of epoll_ctl.
+      [[nodiscard]] inline int tryControl(int operation, int fd, std::uint32_t events) {
+         epoll_event event{};
+         event.events  = events | EPOLLONESHOT;
+         event.data.fd = fd;
+         return epoll_ctl(m_epollFd, operation, fd, &event) < 0 ? errno : 0;
+      }
+
+     private:
+      int                                                    m_epollFd;
+      std::atomic_bool                                       m_leading{ false };
+      std::mutex                                             m_registrationMutex;
+      std::unordered_map<int, std::shared_ptr<Registration>> m_registrations;
+   };
+#endif
+
+   class TnTThreadPool {
+     public:
+      /// @brief Creates the pool and starts its workers.
+      /// @param threadCount [Optional; Default=defaultThreadCount()] The number of worker threads.
+      /// @param memoryResource [Optional; Default=std::pmr::get_default_resource()] Used for job queue storage, jobs too large to store inline and promise state.
+      /// Must be thread-safe, as submitters and workers allocate from it concurrently, and must outlive the pool.
+      TnTThreadPool(std::size_t threadCount = defaultThreadCount(), std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource()) :
+          TnTThreadPool(threadCount, ThreadOptions{}, memoryResource) {}
+
+      /// @brief Creates the pool, starting its workers as described by @paramref threadOptions.
+      /// @param threadCount The number of worker threads, or the most that will be started in lazy mode.
+      /// @param threadOptions The stack size of the pool's threads and whether workers start lazily.
+      /// @param memoryResource [Optional; Default=std::pmr::get_default_resource()] Used for job queue storage, jobs too large to store inline and promise state.
+      /// Must be thread-safe, as submitters and workers allocate from it concurrently, and must outlive the pool.
+      TnTThreadPool(std::size_t threadCount, const ThreadOptions& threadOptions, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource()) :
+          m_memoryResource(memoryResource),
+          m_threadOptions(threadOptions),
+          m_threadCount(threadCount),
+          m_blockingQueue(memoryResource) {
+         buildQueueDomains();
+         init();
+         awaitReadyWorkers();
+      }
+
+      /// @brief Creates the pool with workers pinned to their last level cache, or one pinned worker per logical CPU or per physical core, read from the CPU topology.
+      /// @param placement Where to place the workers.
+      /// @param memoryResource [Optional; Default=std::pmr::get_default_resource()] Used for job queue storage, jobs too large to store inline and promise state.
+      /// Must be thread-safe, as submitters and workers allocate from it concurrently, and must outlive the pool.
+      /// @remarks The worker count is capped by any cgroup CPU quota, keeping workers spread across the last level caches. Where the topology cannot be read the pool starts
+      /// @see defaultThreadCount unpinned workers. Resizing the pool later reuses the same placements in order, wrapping around if it grows past them.
+      explicit TnTThreadPool(WorkerPlacement placement, std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource()) :
+          m_memoryResource(memoryResource),
+          m_placement(placement),
+          m_threadCount(0),
+          m_blockingQueue(memoryResource) {
+         buildQueueDomains();
+         m_threadCount = m_workerSlots.empty() ? defaultThreadCount() : m_workerSlots.size();
+         init();
+         awaitReadyWorkers();
+      }
+
+      ~TnTThreadPool() { cleanUp(); }
+
+      /// @brief Submits a job to the thread pool queue for execution.
+      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+      /// @tparam Args [Optional] Arguments to provide to the job.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      template<typename Job, typename... Args>
+      inline void submit(Job&& job, Args&&... args) {
+         if constexpr(sizeof...(Args) == 0) {
+            queueJob(std::forward<Job>(job));
+         }
+         else {
+            queueJob(bindJob(std::forward<Job>(job), std::forward<Args>(args)...));
+         }
+      }
+
+      /// @brief Submits a job to the thread pool queue and allows the user to retrieve a return value from the job.
+      /// @tparam ReturnValue [Optional] The return value of the job. Deduced from what the job returns when called with the submitted arguments if omitted.
+      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+      /// @tparam Args [Optional] Arguments to provide to the job.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @returns An std::future of the return value. To wait for the return value use future.wait() or one of its alternate forms.
+      /// @remarks Results are moved into the future, so move-only return types such as std::unique_ptr work without copies.
+      template<typename ReturnValue = DeduceReturnValue, typename Job, typename... Args>
+      [[nodiscard]] inline auto submitForReturn(Job&& job, Args&&... args) {
+         assertInvocable<Job, Args...>();
+         using Result = JobResult<ReturnValue, Job, Args...>;
+
+         std::promise<Result> promise{ std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>{ m_memoryResource } };
+         std::future<Result>  future = promise.get_future();
+
+         queueJob(PromisedJob<Result, BoundJobFor<Job, Args...>>{ std::move(promise), bindJob(std::forward<Job>(job), std::forward<Args>(args)...) });
+         return future;
+      }
+
+      /// @brief Like @see submitForReturn, but the returned future can claim the job while it is still queued and run it on the thread that waits for it. This saves the
+      /// queueing delay, and a thread that would otherwise block, when the pool is backlogged.
+      /// @tparam ReturnValue [Optional] The return value of the job. Deduced from what the job returns when called with the submitted arguments if omitted.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @returns A @see ClaimableFuture of the return value.
+      /// @remarks A worker and a waiting thread race for the job through a single atomic claim, so it runs exactly once. A job claimed by a waiter stays queued, and the
+      /// worker that dequeues it drops it.
+      template<typename ReturnValue = DeduceReturnValue, typename Job, typename... Args>
+      [[nodiscard]] inline auto submitForReturnClaimable(Job&& job, Args&&... args) {
+         assertInvocable<Job, Args...>();
+         using Result = JobResult<ReturnValue, Job, Args...>;
+         using State  = ClaimableState<Result, BoundJobFor<Job, Args...>>;
+
+         std::shared_ptr<detail::ClaimableJob> state =
+             std::allocate_shared<State>(std::pmr::polymorphic_allocator<std::byte>{ m_memoryResource }, m_memoryResource, bindJob(std::forward<Job>(job), std::forward<Args>(args)...));
+         auto future = static_cast<State&>(*state).promise.get_future();
+         queueJob([state] { state->tryRun(); });
+         return ClaimableFuture<Result>{ std::move(future), std::move(state) };
+      }
+
+      /// @brief Like @see submitForReturn, but concurrent submissions with an equal @paramref key share one execution: while a job for the key is queued or running, later
+      /// submissions do not queue a job and get the first submission's future instead. Once the job finishes, the next submission with that key runs it again.
+      /// @tparam ReturnValue [Optional] The return value of the job. Deduced from what the job returns when called with the submitted arguments if omitted.
+      /// @tparam Key A copyable key with operator== and a std::hash specialization.
+      /// @param key Identifies the computation; only the first submission's job and arguments are used while it is in flight.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @returns An std::shared_future of the return value, shared with every other submission for the same key. Exceptions thrown by the job are rethrown by get().
+      /// Unlike @see submitForReturn, whose jobs must not throw, the exception is caught on the worker and stored in the shared state, as the key has to be retired
+      /// either way.
+      /// @remarks In-flight keys are tracked in a hash map split into @see KEY_STRIPE_COUNT independently locked stripes, so submissions for different keys rarely
+      /// contend. Keys of different types never match, even if they compare equal.
+      template<typename ReturnValue = DeduceReturnValue, typename Key, typename Job, typename... Args>
+      [[nodiscard]] inline auto submitForReturnKeyed(const Key& key, Job&& job, Args&&... args) {
+         assertInvocable<Job, Args...>();
+         return submitKeyed<JobResult<ReturnValue, Job, Args...>, false>(key, std::forward<Job>(job), std::forward<Args>(args)...);
+      }
+
+      /// @brief Like @see submitForReturnKeyed, but a successful result is also kept in the pool's result cache once its job finishes, so later submissions with an
+      /// equal @paramref key get an already-ready future without queuing a job. Jobs that throw are not cached.
+      /// @tparam ReturnValue [Optional] The return value of the job. Deduced from what the job returns when called with the submitted arguments if omitted.
+      /// @tparam Key A copyable key with operator== and a std::hash specialization.
+      /// @param key Identifies the computation; only the first submission's job and arguments are used while it is in flight or cached.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @returns An std::shared_future of the return value, shared with every other submission for the same key. Exceptions thrown by the job are rethrown by get(),
+      /// like @see submitForReturnKeyed.
+      /// @remarks The cache is bounded by @see setResultCacheLimits. Each key stripe evicts with the CLOCK algorithm: a result is kept for another sweep if it was
+      /// read since the last one, and expired results are evicted first. Memoized and @see submitForReturnKeyed submissions never share entries.
+      template<typename ReturnValue = DeduceReturnValue, typename Key, typename Job, typename... Args>
+      [[nodiscard]] inline auto submitForReturnMemoized(const Key& key, Job&& job, Args&&... args) {
+         assertInvocable<Job, Args...>();
+         return submitKeyed<JobResult<ReturnValue, Job, Args...>, true>(key, std::forward<Job>(job), std::forward<Args>(args)...);
+      }
+
+      /// @brief Sets the bounds of the result cache behind @see submitForReturnMemoized. Results beyond the new capacity are evicted right away.
+      /// @param capacity The most results to keep, 0 to cache nothing. It is split evenly across the key stripes, rounding up.
+      /// @param ttl How long a result is served after its job finished. Results do not expire when omitted.
+      inline void setResultCacheLimits(std::size_t capacity, std::chrono::steady_clock::duration ttl = std::chrono::steady_clock::duration::max()) {
+         m_resultCacheCapacity = capacity;
+         m_resultCacheTtl      = ttl;
+         for(KeyStripe& stripe: keyStripes()) {
+            std::scoped_lock lock{ stripe.mutex };
+            evictCached(stripe, stripeCacheCapacity());
+         }
+      }
+
+      /// @brief Drops every cached result. Jobs still in flight are not affected and are cached when they finish.
+      inline void clearResultCache() {
+         for(KeyStripe& stripe: keyStripes()) {
+            std::scoped_lock lock{ stripe.mutex };
+            evictCached(stripe, 0);
+         }
+      }
+
+      /// @returns The number of results the result cache keeps at most, as given to @see setResultCacheLimits.
+      [[nodiscard]] inline std::size_t getResultCacheCapacity() const noexcept { return m_resultCacheCapacity; }
+
+      /// @brief Submits an idempotent job and, if it has not finished after @paramref delay, a duplicate of it. The future gets the result of whichever copy succeeds
+      /// first: a copy that has not started by then is skipped, and the result of one still running is discarded.
+      /// @tparam ReturnValue [Optional] The return value of the job. Deduced from what the job returns when called with the submitted arguments if omitted.
+      /// @param delay How long to wait for the first copy before submitting the duplicate. Replaced by the observed latency once @see setHedgePercentile is set.
+      /// @param job The job to execute. As it may run twice, it must be idempotent, and it and its arguments must be copyable.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @returns An std::future of the return value. If both copies throw, get() rethrows the exception of the last one.
+      /// @remarks Duplicates are submitted by a timer thread that the pool starts on the first hedged submission. A duplicate only helps while there are idle workers
+      /// to run it, so hedging cuts the tail when a few jobs stall on page faults or lock contention, not when the pool is saturated.
+      template<typename ReturnValue = DeduceReturnValue, typename Job, typename... Args>
+      [[nodiscard]] inline auto submitHedged(std::chrono::nanoseconds delay, Job&& job, Args&&... args) {
+         assertInvocable<Job, Args...>();
+         using Result = JobResult<ReturnValue, Job, Args...>;
+         using Bound  = BoundJobFor<Job, Args...>;
+         static_assert(std::is_copy_constructible_v<Bound>, "Hedged jobs may run twice, so the job and its arguments must be copyable.");
+
+         auto  state  = std::allocate_shared<HedgedState<Result>>(std::pmr::polymorphic_allocator<std::byte>{ m_memoryResource }, m_memoryResource);
+         auto  future = state->promise.get_future();
+         Bound bound  = bindJob(std::forward<Job>(job), std::forward<Args>(args)...);
+
+         HedgedJob<Result, Bound> hedge{ state, bound, this, false };
+         ++m_unsettledHedges;
+         try {
+            queueJob(HedgedJob<Result, Bound>{ std::move(state), std::move(bound), this, true });
+         }
+         catch(...) {
+            hedgeSettled();
+            throw;
+         }
+         scheduleHedge(std::chrono::steady_clock::now() + hedgeDelay(delay), [this, hedge = std::move(hedge)]() mutable {
+            if(hedge.state->tryStart()) {
+               try {
+                  queueJob(std::move(hedge));
+               }
+               catch(...) {
+                  if(hedge.state->fail(nullptr)) {
+                     hedgeSettled();
+                  }
+               }
+            }
+         });
+         return future;
+      }
+
+      /// @brief Makes @see submitHedged wait for the given percentile of the latencies observed for its first copies, instead of the delay it was given, once
+      /// enough have been observed. Every first copy is observed, including those that lost to their duplicate, threw, or were skipped because the duplicate won.
+      /// @param percentile The percentile, from 0 to 100. 0, the default, always uses the given delay.
+      inline void setHedgePercentile(double percentile) {
+         std::scoped_lock lock{ m_hedgeMutex };
+         m_hedgePercentile = std::clamp(percentile, 0.0, 100.0);
+      }
+
+      /// @brief Specialization of @see submitForReturn. Uses void as the return value, but unlike @see submit, this function allows that caller to wait for completion.
+      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+      /// @tparam Args [Optional] Arguments to provide to the job.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @returns An std::future<void>. To wait for the job to finish use future.wait() or one of its alternate forms.
+      template<typename Job, typename... Args>
+      [[nodiscard]] inline std::future<void> submitWaitable(Job&& job, Args&&... args) {
+         return submitForReturn<void>(std::forward<Job>(job), std::forward<Args>(args)...);
+      }
+
+      /// @brief Submits a job that is expected to block (synchronous file I/O, sleeping system calls, etc.) to the auxiliary blocking thread set instead of the CPU workers.
+      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+      /// @tparam Args [Optional] Arguments to provide to the job.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      /// @remarks Blocking threads are spawned on demand up to @see setMaxBlockingThreadCount and retire after sitting idle for @see setBlockingKeepAlive. They park while idle and
+      /// are not affected by @see pause.
+      template<typename Job, typename... Args>
+      inline void submitBlocking(Job&& job, Args&&... args) {
+         if constexpr(sizeof...(Args) == 0) {
+            queueBlockingJob(std::forward<Job>(job));
+         }
+         else {
+            queueBlockingJob(bindJob(std::forward<Job>(job), std::forward<Args>(args)...));
+         }
+      }
+
+      /// @brief Creates a job for each item in a container, passing the item as the only parameter to job.
+      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+      /// @tparam Container A container of some sort, must be support a for each loop.
+      /// @param job The job to execute.
+      /// @param container The container to iterate over.
+      /// @remarks This function blocks until each job created from each container item is complete. Do NOT modify the container during this call. The job's parameter can be a non-const lvalue
+      /// reference to modify each element of a non-const container in place, however, the owning container should never be modified during this call. Every item is run by the same
+      /// job object, which is not copied and may be called from several workers at once, so a job with mutable state must synchronize it.
+      template<typename Job, typename Container>
+      inline void forEach(Job&& job, Container&& container) {
+         if constexpr(std::ranges::random_access_range<Container> && std::ranges::sized_range<Container>) {
+            runBatch(job, std::ranges::begin(container), static_cast<std::size_t>(std::ranges::size(container)));
+         }
+         else {
+            // Only the iterators are collected, in the caller's arena, so the elements themselves are never copied.
+            std::array<std::byte, BATCH_ARENA_INLINE_SIZE>       buffer;
+            std::pmr::monotonic_buffer_resource                  arena{ buffer.data(), buffer.size(), m_memoryResource };
+            std::pmr::vector<std::ranges::iterator_t<Container>> positions{ &arena };
+            if constexpr(std::ranges::sized_range<Container>) {
+               positions.reserve(static_cast<std::size_t>(std::ranges::size(container)));
+            }
+
+            for(auto position = std::ranges::begin(container); position != std::ranges::end(container); ++position) {
+               positions.push_back(position);
+            }
+            auto elements = std::views::transform(positions, [](const auto& position) -> decltype(auto) { return *position; });
+            runBatch(job, elements.begin(), positions.size());
+         }
+      }
+
+      /// @brief Creates N number of jobs where N is the number of times a number P can be incremented by @paramref increment from @paramref from to @paramref to.
+      /// @tparam Numeric A numeric value to increment from and to.
+      /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+      /// @param job The job to execute, taking one parameter of type @see Numeric.
+      /// @param from The starting value to increment from (inclusive).
+      /// @param to The ending value to increment to (exclusive).
+      /// @param increment [Optional; Default=1] The value to increment by for each job.
+      /// @remarks This function blocks until all submitted jobs have completed. Do NOT modify an containers that may be backing the stored data. The job should take one parameter whose type is
+      /// @see Numeric.
+      template<typename Numeric, typename Job>
+      inline void forEachIndexed(Job&& job, Numeric from, Numeric to, Numeric increment = 1) requires(std::is_arithmetic_v<Numeric>) {
+         std::array<std::byte, BATCH_ARENA_INLINE_SIZE> buffer;
+         std::pmr::monotonic_buffer_resource           arena{ buffer.data(), buffer.size(), m_memoryResource };
+         std::pmr::vector<Numeric>                     indices{ &arena };
+         if constexpr(std::is_integral_v<Numeric>) {
+            if(from < to && increment > 0) {
+               indices.reserve(static_cast<std::size_t>((to - from + increment - 1) / increment));
+            }
+         }
+
+         for(Numeric index = from; index < to; index += increment) {
+            indices.push_back(index);
+         }
+         runBatch(job, indices.begin(), indices.size());
+      }
+
+      /// @brief Causes the caller to wait for all currently queued jobs to complete before continuing.
+      /// @remarks Also waits for every future returned by @see submitHedged to be settled, including by a duplicate that the timer thread has yet to queue. A
+      /// duplicate whose first copy already succeeded is never run, so it is not waited for.
+      inline void finishAllJobs() {
+         finishBlockingJobsImpl();
+         auto _ = finishAllJobsImpl();
+      }
+
+      /// @brief Pauses the thread pools execution of queued jobs.
+      inline void pause() { auto _ = pauseImpl(); }
+
+      /// @brief Resumes the thread pools job execution.
+      inline void resume() { m_pause = false; }
+
+      /// @brief Completes all jobs in the queue then joins all the threads.
+      inline void shutdown() { auto _ = shutdownImpl(); }
+
+      /// @brief Completes all jobs in the queue, joins all the threads, then starts up a set number of threads.
+      /// @param newThreadCount The number of threads to create in the pool.
+      inline void reset(std::size_t newThreadCount = defaultThreadCount()) {
+         auto lock     = shutdownImpl();
+         m_threadCount = newThreadCount;
+         init();
+         lock.unlock();
+         awaitReadyWorkers();
+      }
+
+      /// @brief Pauses execution of the thread pool, waiting for all in-flight jobs to finish but retaining whats still in the queue. Joins all the threads then spins
+      /// up new ones before resuming execution.
+      /// @param newThreadCount The number of threads in the thread pool.
+      /// @remarks If newThreadCount is 0, this is equivalent to calling shutdown.
+      inline void setThreadCount(std::size_t newThreadCount) {
+         if(newThreadCount == 0) {
+            shutdown();
+            return;
+         }
+         else { 
+            restartWorkers(newThreadCount, false);
+         }
+      }
+
+      /// @brief Re-reads the CPU affinity and cgroup quota through @see refreshDefaultThreadCount and resizes the pool with @see setThreadCount if the result differs from the
+      /// current thread count.
+      /// @returns The thread count after the call.
+      inline std::size_t refreshThreadCount() {
+         std::size_t available = refreshDefaultThreadCount();
+         std::size_t current   = 0;
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            current = m_acceptingJobs ? m_threadCount : 0;
+         }
+         if(available != current) {
+            setThreadCount(available);
+         }
+         return available;
+      }
+
+      /// @brief Attaches the pool to @paramref budget so its workers only run jobs while holding one of the budget's tokens. Passing nullptr detaches the pool again.
+      /// @remarks Workers swap over to the new budget when they next look for work; a token held from the previous budget is returned to it.
+      inline void setCpuBudget(CpuBudget* budget) noexcept { m_cpuBudget.store(budget, std::memory_order_release); }
+
+      /// @brief The most jobs a worker runs on one CPU token while another worker is waiting for a token of the same budget.
+      static constexpr std::size_t CPU_TOKEN_QUANTUM = 16;
+
+      /// @brief Returns the budget the pool is attached to, or nullptr if its workers are only limited by its thread count.
+      [[nodiscard]] inline CpuBudget* getCpuBudget() const noexcept { return m_cpuBudget.load(std::memory_order_acquire); }
+
+      /// @brief Returns the number of threads in the pool. With @see ThreadOptions::lazyStart, only the workers started so far are counted.
+      [[nodiscard]] inline std::size_t getThreadCount() {
+         std::scoped_lock lock{ m_jobQueueMutex };
+         return m_threads.size();
+      }
+
+      /// @brief Sets whether the job queues release memory as they drain. By default each queue keeps the capacity of its deepest point.
+      inline void setQueueShrinkPolicy(ShrinkPolicy shrinkPolicy) {
+         for(auto& domain: m_queueDomains) {
+            std::scoped_lock lock{ domain->mutex };
+            domain->queue.setShrinkPolicy(shrinkPolicy);
+         }
+      }
+
+      /// @brief Grows the job queues up front so that @paramref capacity jobs submitted from outside the pool can be queued without allocating.
+      /// @remarks The capacity is split evenly across the pool's queue domains, as outside submissions are spread evenly across them.
+      inline void reserveQueue(std::size_t capacity) {
+         const std::size_t share = (capacity + m_queueDomains.size() - 1) / m_queueDomains.size();
+         for(auto& domain: m_queueDomains) {
+            std::scoped_lock lock{ domain->mutex };
+            domain->queue.reserve(share);
+         }
+      }
+
+#if defined(__linux__)
+      /// @brief Sets the scheduling policy and nice value or priority the pool's threads run under, so that background pools can yield to latency-critical threads
+      /// without being shrunk. Workers are restarted to apply it, like @see setThreadCount, but a paused pool stays paused; blocking and spare threads apply it the
+      /// next time one starts.
+      /// @throws std::system_error If a worker could not apply @paramref scheduling, i.e. raising priority without CAP_SYS_NICE. The workers keep running either way.
+      inline void setWorkerScheduling(const WorkerScheduling& scheduling) {
+         std::size_t threadCount = 0;
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            m_scheduling      = scheduling;
+            m_schedulingError = 0;
+            threadCount       = m_acceptingJobs ? m_threadCount : 0;
+         }
+
+         if(threadCount != 0) {
+            restartWorkers(threadCount, true);
+            awaitWorkerStartImpl();
+         }
+
+         if(int error = m_schedulingError; error != 0) {
+            throw std::system_error(error, std::system_category(), "Failed to apply worker scheduling");
+         }
+      }
+
+      /// @brief Returns the scheduling set with @see setWorkerScheduling, or std::nullopt if the pool's threads inherit the scheduling of the thread that created them.
+      [[nodiscard]] inline std::optional<WorkerScheduling> getWorkerScheduling() {
+         std::scoped_lock lock{ m_jobQueueMutex };
+         return m_scheduling;
+      }
+#endif
+
+      /// @brief Returns how the pool places its workers.
+      [[nodiscard]] inline WorkerPlacement getWorkerPlacement() const noexcept { return m_placement; }
+
+      /// @brief Returns the number of queue domains, one per last level cache the pool's CPUs span.
+      [[nodiscard]] inline std::size_t getQueueDomainCount() const noexcept { return m_queueDomains.size(); }
+
+      /// @brief Returns the memory resource the pool allocates job storage from.
+      [[nodiscard]] inline std::pmr::memory_resource* getMemoryResource() const noexcept { return m_memoryResource; }
+
+      /// @brief Returns the options the pool starts its threads with.
+      [[nodiscard]] inline const ThreadOptions& getThreadOptions() const noexcept { return m_threadOptions; }
+
+      /// @brief Returns the number of threads currently alive in the blocking thread set.
+      [[nodiscard]] inline std::size_t getBlockingThreadCount() {
+         std::scoped_lock lock{ m_blockingMutex };
+         return m_blockingThreadCount;
+      }
+
+      /// @brief Returns the number of spare workers started so far to stand in for workers inside a @see blockingRegion. Spares are kept until the pool shuts down.
+      [[nodiscard]] inline std::size_t getSpareThreadCount() {
+         std::scoped_lock lock{ m_jobQueueMutex };
+         return m_spareThreads.size();
+      }
+
+      /// @brief Sets the maximum number of threads the blocking thread set may grow to. Jobs submitted while every blocking thread is busy wait in the blocking queue.
+      /// @param maxThreadCount The maximum number of blocking threads, must be at least 1.
+      inline void setMaxBlockingThreadCount(std::size_t maxThreadCount) {
+         std::scoped_lock lock{ m_blockingMutex };
+         m_maxBlockingThreads = std::max<std::size_t>(maxThreadCount, 1);
+      }
+
+      /// @brief Sets how long an idle blocking thread waits for another job before retiring.
+      inline void setBlockingKeepAlive(std::chrono::milliseconds keepAlive) {
+         std::scoped_lock lock{ m_blockingMutex };
+         m_blockingKeepAlive = keepAlive;
+      }
+
+#if defined(TNT_HAS_EPOLL)
+      /// @brief Registers a file descriptor with the pool's reactor, creating the reactor on first use. Idle workers wait on readiness and run @paramref callback as a job.
+      /// @tparam Callback A callable taking one std::uint32_t, the ready epoll event mask.
+      /// @param fd The file descriptor to watch. The pool does not take ownership of it.
+      /// @param events The epoll events to wait for, i.e. EPOLLIN, EPOLLOUT.
+      /// @param callback The callback to run each time the file descriptor becomes ready.
+      /// @remarks A callback is never run concurrently with itself; the file descriptor is re-armed after each callback returns. Jobs submitted while the only idle worker is
+      /// waiting on the reactor may be delayed by up to @see REACTOR_POLL_TIMEOUT_MS.
+      template<typename Callback>
+      inline void registerFd(int fd, std::uint32_t events, Callback&& callback) {
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            if(!m_reactor) {
+               m_reactor = std::make_unique<Reactor>();
+               m_reactorEnabled.store(true, std::memory_order_release);
+            }
+         }
+         m_reactor->add(fd, events, std::forward<Callback>(callback));
+      }
+
+      /// @brief Changes the epoll events a registered file descriptor waits for.
+      inline void modifyFd(int fd, std::uint32_t events) {
+         if(!m_reactorEnabled.load(std::memory_order_acquire)) {
+            throw std::runtime_error("Attempted to modify a file descriptor, but no file descriptor was ever registered.");
+         }
+         m_reactor->modify(fd, events);
+      }
+
+      /// @brief Stops watching a file descriptor. A callback that is already running is allowed to finish.
+      inline void unregisterFd(int fd) {
+         if(m_reactorEnabled.load(std::memory_order_acquire)) {
+            m_reactor->remove(fd);
+         }
+      }
+
+      /// @brief How long the leading worker waits on epoll before checking the job queue again.
+      static constexpr int REACTOR_POLL_TIMEOUT_MS = 1;
+#endif
+
+#if defined(__linux__)
+      /// @brief A dedicated worker pinned to one CPU that busy-polls its own lock-free queue instead of the pool's job queues. It never parks and never takes a pool
+      /// mutex, so a job submitted to it starts within the time it takes the polling CPU to see the write. Created with @see addLowLatencyWorker.
+      /// @remarks The lane keeps its CPU fully busy even when idle, so it should be given a CPU isolated from the scheduler, see @see isolatedCpus. It ignores
+      /// @see pause, but @see finishAllJobs waits for it to drain. Keep job captures within @see Task::INLINE_SIZE bytes so submitting does not allocate.
+      class LowLatencyLane {
+        public:
+         /// @brief Submits a job to this lane. Safe to call from any number of threads.
+         /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+         /// @tparam Args [Optional] Arguments to provide to the job.
+         /// @param job The job to execute.
+         /// @param args Arguments to provide to the job, stored by value as with @see TnTThreadPool::submit.
+         /// @remarks Spins while the lane is full, so a job running on a lane must not submit to that same lane.
+         template<typename Job, typename... Args>
+         inline void submit(Job&& job, Args&&... args) {
+            TnTThreadPool::assertInvocable<Job, Args...>();
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+            auto bound = TnTThreadPool::bindJob(std::forward<Job>(job), std::forward<Args>(args)...);
+            while(!m_ring.tryEmplace(std::move(bound), m_memoryResource)) {
+               detail::cpuRelax();
+            }
+         }
+
+         /// @brief Returns the CPU the lane's worker is pinned to.
+         [[nodiscard]] inline int getCpu() const noexcept { return m_cpu; }
+
+         LowLatencyLane(const LowLatencyLane&)            = delete;
+         LowLatencyLane& operator=(const LowLatencyLane&) = delete;
+
+        private:
+         friend class TnTThreadPool;
+
+         LowLatencyLane(int cpu, std::size_t capacity, std::pmr::memory_resource* memoryResource) : m_ring(capacity), m_memoryResource(memoryResource), m_cpu(cpu) {}
+
+         detail::MpscRing<Task>     m_ring;
+         std::pmr::memory_resource* m_memoryResource;
+         std::atomic_size_t         m_pending{ 0 };
+         std::atomic_bool           m_stop{ false };
+         int                        m_cpu;
+         detail::Thread             m_thread;
+      };
+
+      /// @brief Starts a @see LowLatencyLane worker pinned to @paramref cpu, leaving the rest of the pool as it is.
+      /// @param cpu The CPU to pin the lane's worker to, ideally one listed by @see isolatedCpus.
+      /// @param fifoPriority [Optional; Default=0] If non-zero, the worker runs under SCHED_FIFO at this priority (1-99), which usually requires CAP_SYS_NICE.
+      /// @param capacity [Optional; Default=1024] The number of jobs the lane can hold before submitters spin, rounded up to a power of two.
+      /// @returns The lane, which stays valid until the pool is shut down, reset or destroyed.
+      /// @throws std::system_error If the worker could not be pinned to @paramref cpu or given the requested priority.
+      /// @remarks The worker is started with the pool's @see ThreadOptions::stackSize and touches @see ThreadOptions::prefaultStack bytes of it before this returns.
+      inline LowLatencyLane& addLowLatencyWorker(int cpu, int fifoPriority = 0, std::size_t capacity = DEFAULT_LANE_CAPACITY) {
+         if(cpu < 0) {
+            throw std::system_error(EINVAL, std::system_category(), "Failed to pin low latency worker");
+         }
+         std::unique_ptr<LowLatencyLane> lane{ new LowLatencyLane(cpu, capacity, m_memoryResource) };
+
+         // The lane pins itself, applies its priority and prefaults its stack before it starts polling, then reports back. It only polls if it could be pinned and
+         // given its priority.
+         int         error = 0;
+         const char* what  = nullptr;
+         std::latch  started{ 1 };
+         lane->m_thread = detail::Thread{ m_threadOptions.stackSize, [this, &self = *lane, fifoPriority, &error, &what, &started] {
+            error               = prepareLaneThread(self.m_cpu, fifoPriority, what);
+            const bool prepared = error == 0;
+            if(prepared && m_threadOptions.prefaultStack != 0) {
+               detail::prefaultStack(m_threadOptions.prefaultStack);
+            }
+            started.count_down();
+            if(prepared) {
+               laneExecutor(self);
+            }
+         } };
+         started.wait();
+         if(error != 0) {
+            lane.reset();
+            throw std::system_error(error, std::system_category(), what);
+         }
+
+         std::scoped_lock lock{ m_jobQueueMutex };
+         return *m_lanes.emplace_back(std::move(lane));
+      }
+#endif
+
+     private:
+      /// @brief A job and its decayed arguments stored side by side in one task, so submitting with arguments costs no extra wrapper. std::reference_wrapper arguments are
+      /// stored as plain references, and every other argument is moved into the job, as each task only runs once.
+      template<typename Job, typename... Args>
+      struct BoundJob {
+         Job                 job;
+         std::tuple<Args...> args;
+
+         inline decltype(auto) operator()() { return std::apply(job, std::move(args)); }
+      };
+
+      /// @brief A bound job whose result, or completion for void jobs, is published through a promise.
+      template<typename ReturnValue, typename Bound>
+      struct PromisedJob {
+         std::promise<ReturnValue> promise;
+         Bound                     bound;
+
+         inline void operator()() {
+            if constexpr(std::is_void_v<ReturnValue>) {
+               bound();
+               promise.set_value();
+            }
+            else {
+               promise.set_value(bound());
+            }
+         }
+      };
+
+      template<typename Job, typename... Args>
+      using BoundJobFor = BoundJob<std::decay_t<Job>, std::unwrap_ref_decay_t<Args>...>;
+
+      template<typename ReturnValue, typename Job, typename... Args>
+      using JobResult = typename std::conditional_t<std::is_same_v<ReturnValue, DeduceReturnValue>,
+                                                    std::invoke_result<std::decay_t<Job>&, std::unwrap_ref_decay_t<Args>&&...>,
+                                                    std::type_identity<ReturnValue>>::type;
+
+      // Type-erased entry of the keyed map. The type tag is the address of s_keyedEntryType for the entry's key and result types and whether it is memoized.
+      // Everything but type and hash is guarded by the stripe's mutex. Entries are allocated from the pool's memory resource and hand themselves back to it through
+      // destroy, as only the derived entry knows its size.
+      struct KeyedEntryBase {
+         KeyedEntryBase(const void* entryType, std::size_t entryHash, std::pmr::memory_resource* entryMemoryResource) :
+             type(entryType), hash(entryHash), memoryResource(entryMemoryResource) {}
+         virtual ~KeyedEntryBase() = default;
+
+         virtual void destroy() noexcept = 0;
+
+         const void*                           type;
+         const std::size_t                     hash;
+         std::pmr::memory_resource* const      memoryResource;
+         bool                                  cached{ false };
+         bool                                  referenced{ false };
+         std::size_t                           clockSlot{ 0 };
+         std::chrono::steady_clock::time_point expires;
+      };
+
+      template<typename Key, typename Result, bool Memoized>
+      static inline char s_keyedEntryType = 0;
+
+      template<typename Key, typename Result>
+      struct KeyedEntry final : KeyedEntryBase {
+         KeyedEntry(const void* entryType, std::size_t entryHash, std::pmr::memory_resource* entryMemoryResource, const Key& entryKey, std::shared_future<Result> entryFuture) :
+             KeyedEntryBase(entryType, entryHash, entryMemoryResource), key(entryKey), future(std::move(entryFuture)) {}
+
+         void destroy() noexcept override { std::pmr::polymorphic_allocator<KeyedEntry>{ memoryResource }.delete_object(this); }
+
+         Key                        key;
+         std::shared_future<Result> future;
+      };
+
+      struct KeyedEntryDeleter {
+         inline void operator()(KeyedEntryBase* entry) const noexcept { entry->destroy(); }
+      };
+
+      using KeyedEntryPtr = std::unique_ptr<KeyedEntryBase, KeyedEntryDeleter>;
+
+      // Padded to a cache line each, so that stripes locked by different threads do not share one. clock holds the stripe's cached entries, in the order the
+      // CLOCK hand sweeps them.
+      struct alignas(64) KeyStripe {
+         explicit KeyStripe(std::pmr::memory_resource* memoryResource) : entries(memoryResource), clock(memoryResource) {}
+
+         std::mutex                                                mutex;
+         std::pmr::unordered_multimap<std::size_t, KeyedEntryPtr> entries;
+         std::pmr::vector<KeyedEntryBase*>                         clock;
+         std::size_t                                               hand{ 0 };
+      };
+
+      // Publishes the result, or the exception, to everyone sharing the future while retiring the key, so a caller woken by the future already sees it retired. Unlike
+      // PromisedJob, it catches what the job throws: letting it escape would leave the key in flight forever, so the exception goes into the promise instead.
+      template<typename ReturnValue, typename Bound>
+      struct KeyedJob {
+         std::promise<ReturnValue> promise;
+         Bound                     bound;
+         TnTThreadPool*            pool;
+         KeyedEntryBase*           entry;
+         bool                      memoize;
+
+         inline void operator()() {
+            std::exception_ptr failure;
+            try {
+               if constexpr(std::is_void_v<ReturnValue>) {
+                  bound();
+                  pool->retireKeyed(entry, memoize, [this] { promise.set_value(); });
+               }
+               else {
+                  decltype(auto) result = bound();
+                  pool->retireKeyed(entry, memoize, [this, &result] { promise.set_value(std::forward<decltype(result)>(result)); });
+               }
+            }
+            catch(...) {
+               failure = std::current_exception();
+            }
+            if(failure) {
+               pool->retireKeyed(entry, false, [this, &failure] { promise.set_exception(failure); });
+            }
+         }
+      };
+
+      template<typename Result, typename Bound>
+      struct ClaimableState final : detail::ClaimableJob {
+         ClaimableState(std::pmr::memory_resource* memoryResource, Bound&& job) :
+             promise(std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>{ memoryResource }), bound(std::move(job)) {}
+
+         inline void run() noexcept override {
+            try {
+               if constexpr(std::is_void_v<Result>) {
+                  bound();
+                  promise.set_value();
+               }
+               else {
+                  promise.set_value(bound());
+               }
+            }
+            catch(...) {
+               promise.set_exception(std::current_exception());
+            }
+         }
+
+         std::promise<Result> promise;
+         Bound                bound;
+      };
+
+      // Shared by both copies of a hedged job. Every copy that was queued is counted in running until it ends; the first to succeed settles the promise, or the
+      // last to end does with the failure. succeed and fail return true for the call that settled it.
+      template<typename Result>
+      struct HedgedState {
+         explicit HedgedState(std::pmr::memory_resource* memoryResource) :
+             promise(std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>{ memoryResource }) {}
+
+         [[nodiscard]] inline bool tryStart() {
+            std::scoped_lock lock{ mutex };
+            if(settled) {
+               return false;
+            }
+            ++running;
+            return true;
+         }
+
+         template<typename Publish>
+         [[nodiscard]] inline bool succeed(Publish&& publish) {
+            std::scoped_lock lock{ mutex };
+            if(settled) {
+               return false;
+            }
+            publish();
+            settled = true;
+            return true;
+         }
+
+         // Ends a copy that threw, or that could not be queued when error is null.
+         [[nodiscard]] inline bool fail(std::exception_ptr error) {
+            std::scoped_lock lock{ mutex };
+            if(error) {
+               failure = std::move(error);
+            }
+            if(--running != 0 || settled) {
+               return false;
+            }
+            promise.set_exception(failure);
+            settled = true;
+            return true;
+         }
+
+         std::mutex                            mutex;
+         std::promise<Result>                  promise;
+         std::exception_ptr                    failure;
+         int                                   running{ 1 };
+         std::atomic_bool                      settled{ false };
+         std::chrono::steady_clock::time_point submitted{ std::chrono::steady_clock::now() };
+      };
+
+      template<typename Result, typename Bound>
+      struct HedgedJob {
+         std::shared_ptr<HedgedState<Result>> state;
+         Bound                                bound;
+         TnTThreadPool*                       pool;
+         bool                                 first;
+
+         inline void operator()() {
+            // The other copy already won, so this one is cancelled before it starts. A copy that is already running cannot be stopped; it runs to completion and
+            // its result is discarded.
+            if(state->settled) {
+               recordLatency();
+               return;
+            }
+            bool settled = false;
+            try {
+               if constexpr(std::is_void_v<Result>) {
+                  bound();
+                  settled = state->succeed([this] { state->promise.set_value(); });
+               }
+               else {
+                  decltype(auto) result = bound();
+                  settled               = state->succeed([this, &result] { state->promise.set_value(std::forward<decltype(result)>(result)); });
+               }
+            }
+            catch(...) {
+               if(state->fail(std::current_exception())) {
+                  pool->hedgeSettled();
+               }
+               recordLatency();
+               return;
+            }
+            if(settled) {
+               pool->hedgeSettled();
+            }
+            recordLatency();
+         }
+
+         // Every first copy is sampled, whether it won, lost, threw or was skipped, so the slow ones the hedge exists for are not left out of the percentile. A
+         // skipped copy contributes the time it waited, a lower bound on its latency.
+         inline void recordLatency() const {
+            if(first) {
+               pool->recordHedgeLatency(std::chrono::steady_clock::now() - state->submitted);
+            }
+         }
+      };
+
+      struct PendingHedge {
+         std::chrono::steady_clock::time_point deadline;
+         Task                                  launch;
+      };
+
+      template<typename Job, typename... Args>
+      static consteval void assertInvocable() {
+         static_assert(std::is_invocable_v<std::decay_t<Job>&, std::unwrap_ref_decay_t<Args>&&...>,
+                       "The job cannot be called with the submitted arguments. Arguments are stored by value, so a job taking a non-const lvalue reference would only modify "
+                       "the pool's copy. Pass std::ref(argument) to have the job operate on the caller's object instead.");
+      }
+
+      template<typename Job, typename... Args>
+      [[nodiscard]] static inline BoundJobFor<Job, Args...> bindJob(Job&& job, Args&&... args) {
+         assertInvocable<Job, Args...>();
+         return { std::forward<Job>(job), std::tuple<std::unwrap_ref_decay_t<Args>...>(std::forward<Args>(args)...) };
+      }
+
+      struct BlockingThread {
+         detail::Thread thread;
+         bool           finished{ false };
+      };
+
+      // The CPUs one worker is pinned to and the domain it belongs to.
+      struct WorkerSlot {
+         std::size_t      domain;
+         std::vector<int> cpus;
+      };
+
+      // A job queue shared by the workers on one last level cache.
+      struct QueueDomain {
+         QueueDomain(std::pmr::memory_resource* memoryResource, int numaNode) : queue(memoryResource), node(numaNode) {}
+
+         std::mutex               mutex;
+         RingBuffer<Task>         queue;
+         std::atomic_size_t       size{ 0 };   // Mirrors queue.size() so that empty domains are skipped without taking their mutex.
+         int                      node;
+         std::vector<int>         cpus;
+         std::vector<std::size_t> stealOrder;
+      };
+
+      inline void init() {
+         m_execute = true;
+         {
+            std::scoped_lock lock{ m_blockingMutex };
+            m_blockingAccepting = true;
+         }
+         m_activeDomains = std::min(m_queueDomains.size(), std::max<std::size_t>(m_threadCount, 1));
+
+         // Lazily started pools only start enough workers for the jobs already waiting, startWorkerOnDemand starts the rest.
+         const std::size_t startNow = m_threadOptions.lazyStart ? std::min<std::size_t>(m_queuedTasks, m_threadCount) : m_threadCount;
+         m_workersToStart           = m_threadCount;
+         if(m_threadOptions.treeStart && startNow != 0) {
+            // Each worker fills its children's slots, so the vector is sized up front and never reallocated while the tree grows.
+            m_threads.resize(startNow);
+            m_workersToStart -= startNow;
+            m_startingWorkers += startNow;
+            m_threads[0] = makeWorkerImpl(0, startNow);
+         }
+         else {
+            for(std::size_t i = 0; i < startNow; ++i) {
+               startWorkerImpl();
+            }
+         }
+         m_acceptingJobs = true;
+      }
+
+      // Requires m_jobQueueMutex once the pool is running.
+      inline void startWorkerImpl() {
+         --m_workersToStart;
+         ++m_startingWorkers;
+         m_threads.push_back(makeWorkerImpl(m_threads.size(), 0));
+      }
+
+      // Workers with an index below treeEnd start the workers at 2 * index + 1 and 2 * index + 2.
+      [[nodiscard]] inline detail::Thread makeWorkerImpl(std::size_t index, std::size_t treeEnd) {
+         return detail::Thread{ m_threadOptions.stackSize, std::bind(&TnTThreadPool::executor, this, index, treeEnd) };
+      }
+
+      // Pauses the pool, waits for in-flight jobs, joins the workers and starts newThreadCount new ones. The pool is resumed afterwards unless keepPause is set and it
+      // was already paused.
+      inline void restartWorkers(std::size_t newThreadCount, bool keepPause) {
+         const bool wasPaused = m_pause;
+         m_threadCount        = newThreadCount;
+         auto lock            = pauseImpl();
+         m_execute            = false;
+         lock.unlock();
+         joinThreadsImpl();
+         lock.lock();
+         init();
+         m_pause = keepPause && wasPaused;
+         lock.unlock();
+         awaitReadyWorkers();
+      }
+
+      // Waits for the workers to finish starting when the pool promises to return with warmed-up workers.
+      inline void awaitReadyWorkers() {
+         if(m_threadOptions.treeStart || m_threadOptions.prefaultStack != 0 || m_threadOptions.warmUp) {
+            awaitWorkerStartImpl();
+         }
+      }
+
+      // Called after queueing work. Starts another worker if the pool starts lazily, has not started all of them yet and none is idle to pick the work up. Waits for a
+      // start-up tree to finish first, as it is still filling in m_threads.
+      inline void startWorkerOnDemand() {
+         if(m_workersToStart.load(std::memory_order_relaxed) == 0 || m_idleWorkers.load(std::memory_order_relaxed) != 0) {
+            return;
+         }
+         std::scoped_lock lock{ m_jobQueueMutex };
+         if(m_workersToStart != 0 && m_execute && (!m_threadOptions.treeStart || m_startingWorkers == 0)) {
+            startWorkerImpl();
+         }
+      }
+
+      // Waits until every worker started so far has started its children, pinned itself, applied the pool's scheduling and warmed up.
+      inline void awaitWorkerStartImpl() {
+         for(std::size_t starting = m_startingWorkers; starting != 0; starting = m_startingWorkers) {
+            m_startingWorkers.wait(starting);
+         }
+      }
+
+      inline void executor(std::size_t index, std::size_t treeEnd) {
+         // Children are started before this worker pins itself or changes its scheduling, as they would inherit both.
+         for(std::size_t child = 2 * index + 1; child < treeEnd && child <= 2 * index + 2; ++child) {
+            m_threads[child] = makeWorkerImpl(child, treeEnd);
+         }
+
+         const WorkerSlot* slot   = m_workerSlots.empty() ? nullptr : &m_workerSlots[index % m_workerSlots.size()];
+         const std::size_t domain = slot != nullptr ? slot->domain : index % m_queueDomains.size();
+         s_currentPool            = this;
+         s_queueDomain            = domain;
+#if defined(__linux__)
+         if(slot != nullptr) {
+            detail::pinCurrentThread(slot->cpus);
+         }
+         else if(m_placement == WorkerPlacement::LastLevelCaches) {
+            detail::pinCurrentThread(m_queueDomains[domain]->cpus);
+         }
+         if(int error = applyWorkerScheduling(); error != 0) {
+            int expected = 0;
+            m_schedulingError.compare_exchange_strong(expected, error);
+         }
+#endif
+         if(m_threadOptions.prefaultStack != 0) {
+            detail::prefaultStack(m_threadOptions.prefaultStack);
+         }
+         if(m_threadOptions.warmUp) {
+            m_threadOptions.warmUp(index);
+         }
+         if(--m_startingWorkers == 0) {
+            m_startingWorkers.notify_all();
+         }
+
+         Task currentJob;
+         bool idle = false;
+         while(m_execute) {
+            if(runNextJob(currentJob, holdCpuToken())) {
+               if(idle) {
+                  idle = false;
+                  --m_idleWorkers;
+               }
+               continue;
+            }
+            if(!idle) {
+               idle = true;
+               ++m_idleWorkers;
+            }
+            releaseCpuToken();
+#if defined(TNT_HAS_EPOLL)
+            if(!m_pause && m_reactorEnabled.load(std::memory_order_acquire)) {
+               pollReactor();
+            }
+#endif
+         }
+         if(idle) {
+            --m_idleWorkers;
+         }
+         releaseCpuToken();
+         s_currentPool = nullptr;
+      }
+
+      /// @param mayRun False if the worker could not get a CPU token, in which case it only wakes waiters like it would on an empty queue.
+      /// @returns False if there was no job to run.
+      inline bool runNextJob(Task& currentJob, bool mayRun = true) {
+         if(!mayRun || m_pause || !takeJob(currentJob)) {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            m_cv.notify_all();
+            std::this_thread::yield();
+            return false;
+         }
+         currentJob();
+         currentJob.reset();
+         --m_runningTasks;
+         return true;
+      }
+
+      // Takes the next job from the worker's own queue domain, then steals from the other domains, those on the same NUMA node first.
+      inline bool takeJob(Task& currentJob) {
+         QueueDomain& home = *m_queueDomains[s_queueDomain];
+         if(takeJobFrom(home, currentJob)) {
+            return true;
+         }
+         for(std::size_t victim: home.stealOrder) {
+            if(takeJobFrom(*m_queueDomains[victim], currentJob)) {
+               return true;
+            }
+         }
+         return false;
+      }
+
+      // Counts the job as running in the same critical section that checks m_pause, see pauseImpl.
+      inline bool takeJobFrom(QueueDomain& domain, Task& currentJob) {
+         if(domain.size.load(std::memory_order_relaxed) == 0) {
+            return false;
+         }
+         std::scoped_lock lock{ domain.mutex };
+         if(domain.queue.empty() || m_pause) {
+            return false;
+         }
+         ++m_runningTasks;
+         currentJob = std::move(domain.queue.front());
+         domain.queue.pop();
+         --domain.size;
+         --m_queuedTasks;
+         return true;
+      }
+
+      // Workers queue onto their own domain so that nested jobs stay on the same cache, everyone else spreads their jobs across the domains that have workers.
+      [[nodiscard]] inline std::size_t submitDomain() noexcept {
+         if(s_currentPool == this) {
+            return s_queueDomain;
+         }
+         if(m_queueDomains.size() == 1) {
+            return 0;
+         }
+         return m_nextDomain.fetch_add(1, std::memory_order_relaxed) % m_activeDomains.load(std::memory_order_relaxed);
+      }
+
+      // Groups the CPUs the process may run on by last level cache, one queue domain per group. With WorkerPlacement::LastLevelCaches, workers of a domain are pinned
+      // to its CPUs. Machines with a single last level cache, and platforms without a topology, get one unpinned domain. With WorkerPlacement::LogicalCpus or
+      // WorkerPlacement::PhysicalCores, each logical CPU or each core also becomes a worker slot; slots are taken from each domain in turn so that a quota-capped pool
+      // still spans every cache.
+      inline void buildQueueDomains() {
+#if defined(__linux__)
+         auto topology = detail::topologyOverride() ? *detail::topologyOverride() : detail::readCpuTopology(detail::affinityCpus());
+         std::ranges::sort(topology, [](const detail::CpuLocation& left, const detail::CpuLocation& right) {
+            return std::tie(left.node, left.llc, left.core, left.cpu) < std::tie(right.node, right.llc, right.core, right.cpu);
+         });
+
+         std::vector<std::vector<WorkerSlot>> domainSlots;
+         for(std::size_t i = 0; i < topology.size(); ++i) {
+            bool newDomain = i == 0 || topology[i].llc != topology[i - 1].llc || topology[i].node != topology[i - 1].node;
+            if(newDomain) {
+               m_queueDomains.push_back(std::make_unique<QueueDomain>(m_memoryResource, topology[i].node));
+               domainSlots.emplace_back();
+            }
+            m_queueDomains.back()->cpus.push_back(topology[i].cpu);
+            if(newDomain || m_placement == WorkerPlacement::LogicalCpus || topology[i].core != topology[i - 1].core) {
+               domainSlots.back().push_back(WorkerSlot{ m_queueDomains.size() - 1, {} });
+            }
+            domainSlots.back().back().cpus.push_back(topology[i].cpu);
+         }
+         if(m_queueDomains.size() == 1) {
+            m_queueDomains.back()->cpus.clear();
+         }
+
+         if(m_placement == WorkerPlacement::LogicalCpus || m_placement == WorkerPlacement::PhysicalCores) {
+            for(std::size_t round = 0; m_workerSlots.size() < topology.size(); ++round) {
+               bool found = false;
+               for(auto& slots: domainSlots) {
+                  if(round < slots.size()) {
+                     m_workerSlots.push_back(std::move(slots[round]));
+                     found = true;
+                  }
+               }
+               if(!found) {
+                  break;
+               }
+            }
+            if(auto limit = detail::cachedCgroupCpuLimit(); limit && *limit < m_workerSlots.size()) {
+               m_workerSlots.resize(std::max<std::size_t>(*limit, 1));
+            }
+         }
+#endif
+         if(m_queueDomains.empty()) {
+            m_queueDomains.push_back(std::make_unique<QueueDomain>(m_memoryResource, 0));
+         }
+
+         // Each domain steals from the others starting with its neighbours, so idle workers do not all converge on the same victim.
+         const std::size_t domainCount = m_queueDomains.size();
+         for(std::size_t domain = 0; domain < domainCount; ++domain) {
+            auto& stealOrder = m_queueDomains[domain]->stealOrder;
+            for(bool sameNode: { true, false }) {
+               for(std::size_t offset = 1; offset < domainCount; ++offset) {
+                  std::size_t victim = (domain + offset) % domainCount;
+                  if((m_queueDomains[victim]->node == m_queueDomains[domain]->node) == sameNode) {
+                     stealOrder.push_back(victim);
+                  }
+               }
+            }
+         }
+      }
+
+#if defined(__linux__)
+      // Returns 0 when no scheduling was set. Only workers report a failure, spare and blocking threads would fail the same way.
+      [[nodiscard]] inline int applyWorkerScheduling() {
+         std::optional<WorkerScheduling> scheduling;
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            scheduling = m_scheduling;
+         }
+         return scheduling ? detail::applyScheduling(*scheduling) : 0;
+      }
+
+      // Pins the calling lane thread to cpu and, if fifoPriority is non-zero, moves it to SCHED_FIFO. Returns 0 on success, otherwise the error, with what set to the
+      // step that failed.
+      [[nodiscard]] static inline int prepareLaneThread(int cpu, int fifoPriority, const char*& what) {
+         what                         = "Failed to pin low latency worker";
+         const std::size_t cpuSetSize = static_cast<std::size_t>(cpu) + 1;
+         cpu_set_t*        cpuSet     = CPU_ALLOC(cpuSetSize);
+         if(cpuSet == nullptr) {
+            return ENOMEM;
+         }
+         CPU_ZERO_S(CPU_ALLOC_SIZE(cpuSetSize), cpuSet);
+         CPU_SET_S(static_cast<std::size_t>(cpu), CPU_ALLOC_SIZE(cpuSetSize), cpuSet);
+         int error = pthread_setaffinity_np(pthread_self(), CPU_ALLOC_SIZE(cpuSetSize), cpuSet);
+         CPU_FREE(cpuSet);
+         if(error != 0 || fifoPriority == 0) {
+            return error;
+         }
+
+         what = "Failed to set SCHED_FIFO on low latency worker";
+         sched_param parameters{};
+         parameters.sched_priority = fifoPriority;
+         return pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+      }
+
+      inline void laneExecutor(LowLatencyLane& lane) {
+         s_currentPool = this;
+         Task currentJob;
+         while(!lane.m_stop.load(std::memory_order_relaxed)) {
+            if(!lane.m_ring.tryPop(currentJob)) {
+               detail::cpuRelax();
+               continue;
+            }
+            currentJob();
+            currentJob.reset();
+            // The last job out wakes finishAllJobs through the counter itself. Notifying an atomic nobody waits on does not make a system call.
+            if(lane.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+               lane.m_pending.notify_all();
+            }
+         }
+         s_currentPool = nullptr;
+      }
+
+      // Lanes are joined as they are destroyed, outside the lock.
+      inline void stopLowLatencyLanesImpl() {
+         std::vector<std::unique_ptr<LowLatencyLane>> lanes;
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            lanes.swap(m_lanes);
+         }
+         for(auto& lane: lanes) {
+            lane->m_stop = true;
+         }
+      }
+#endif
+
+      // Spare workers park until a worker enters a blocking region, then run jobs until there are no more blocked workers than active spares.
+      inline void spareExecutor(std::size_t domain) {
+         s_currentPool = this;
+         s_queueDomain = domain;
+#if defined(__linux__)
+         static_cast<void>(applyWorkerScheduling());
+#endif
+         Task             currentJob;
+         std::unique_lock lock{ m_jobQueueMutex };
+         while(true) {
+            m_spareCv.wait(lock, [this] { return m_stopSpares || (m_execute && m_activeSpares < m_blockedWorkers); });
+            if(m_stopSpares) {
+               break;
+            }
+            ++m_activeSpares;
+            lock.unlock();
+
+            while(m_execute && m_activeSpares <= m_blockedWorkers) {
+               if(!runNextJob(currentJob, holdCpuToken())) {
+                  releaseCpuToken();
+               }
+            }
+            releaseCpuToken();
+
+            lock.lock();
+            --m_activeSpares;
+         }
+         s_currentPool = nullptr;
+      }
+
+      /// @brief Makes sure the calling worker holds a token of the pool's CPU budget before it takes a job, waiting briefly for one if there is queued work.
+      /// @returns False if the pool has a budget and no token could be had, or the worker just handed its token back to let a waiting worker have a turn, true otherwise.
+      inline bool holdCpuToken() {
+         CpuBudget* budget = m_cpuBudget.load(std::memory_order_acquire);
+         if(s_heldCpuBudget == budget) {
+            if(budget == nullptr || ++s_jobsOnCpuToken < CPU_TOKEN_QUANTUM || !budget->contended()) {
+               return true;
+            }
+            // Sits out one round, so the waiter woken by the release takes the token before this worker asks for it again.
+            releaseCpuToken();
+            return false;
+         }
+         releaseCpuToken();
+         if(budget == nullptr) {
+            return true;
+         }
+         if(m_queuedTasks == 0 || m_pause || !budget->tryAcquireFor(CPU_TOKEN_WAIT)) {
+            return false;
+         }
+         s_heldCpuBudget  = budget;
+         s_jobsOnCpuToken = 0;
+         return true;
+      }
+
+      /// @brief Returns the calling worker's CPU token, if it holds one, so that other pools sharing the budget can use it.
+      static inline void releaseCpuToken() {
+         if(s_heldCpuBudget != nullptr) {
+            s_heldCpuBudget->release();
+            s_heldCpuBudget = nullptr;
+         }
+      }
+
+      /// @returns The budget the worker's CPU token was handed back to, so @see endBlocking can take one again.
+      /// @remarks A spare that has to be started is only reserved under m_jobQueueMutex. The thread itself is created after releasing it, so submitters and idle workers
+      /// do not stall on the lock for the length of an mmap and a clone.
+      [[nodiscard]] inline CpuBudget* beginBlocking() {
+         CpuBudget* heldBudget = s_heldCpuBudget;
+         releaseCpuToken();
+         bool startSpare = false;
+         {
+            std::scoped_lock  lock{ m_jobQueueMutex };
+            const std::size_t spares = m_spareThreads.size() + m_startingSpares;
+            ++m_blockedWorkers;
+            if(spares < m_blockedWorkers && spares < MAX_SPARE_THREADS) {
+               ++m_startingSpares;
+               startSpare = true;
+            }
+         }
+
+         if(startSpare) {
+            detail::Thread spare;
+            try {
+               spare = detail::Thread{ m_threadOptions.stackSize, std::bind(&TnTThreadPool::spareExecutor, this, s_queueDomain) };
+            }
+            catch(...) {
+               {
+                  std::scoped_lock lock{ m_jobQueueMutex };
+                  --m_startingSpares;
+               }
+               endBlocking(heldBudget);
+               throw;
+            }
+            std::scoped_lock lock{ m_jobQueueMutex };
+            --m_startingSpares;
+            m_spareThreads.push_back(std::move(spare));
+         }
+         m_spareCv.notify_one();
+         return heldBudget;
+      }
+
+      // Waits without a bound for a token of the budget the worker held when the region began, as the rest of its job must not run beyond the budget's capacity. Since
+      // holders hand their tokens back between jobs while anyone waits, the wait lasts at most until some holder finishes its current job.
+      inline void endBlocking(CpuBudget* heldBudget) {
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            --m_blockedWorkers;
+         }
+         if(heldBudget != nullptr) {
+            heldBudget->acquire();
+            s_heldCpuBudget  = heldBudget;
+            s_jobsOnCpuToken = 0;
+         }
+      }
+
+      inline void stopSpareThreadsImpl() {
+         {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            m_stopSpares = true;
+         }
+         m_spareCv.notify_all();
+         m_spareThreads.clear();
+         std::scoped_lock lock{ m_jobQueueMutex };
+         m_stopSpares = false;
+      }
+
+#if defined(TNT_HAS_EPOLL)
+      inline void pollReactor() {
+         if(!m_reactor->tryLead()) {
+            return;
+         }
+
+         Reactor::Events events;
+         std::size_t     ready = m_reactor->wait(events, REACTOR_POLL_TIMEOUT_MS);
+         if(ready == 0) {
+            return;
+         }
+
+         // A worker polling the reactor has handed back its CPU token, so when the pool is on a budget every callback goes through the queue instead of running inline.
+         // The inline callback is counted as running in the same critical section that checks m_pause, like takeJobFrom, so pause and finishAllJobs wait for it.
+         bool runFirst = m_cpuBudget.load(std::memory_order_acquire) == nullptr;
+         {
+            QueueDomain&     domain = *m_queueDomains[s_queueDomain];
+            std::scoped_lock lock{ domain.mutex };
+            runFirst = runFirst && !m_pause;
+            if(runFirst) {
+               ++m_runningTasks;
+            }
+            for(std::size_t i = runFirst ? 1 : 0; i < ready; ++i) {
+               domain.queue.emplace([this, fd = events[i].data.fd, readyEvents = events[i].events] { m_reactor->dispatch(fd, readyEvents); }, m_memoryResource);
+               ++domain.size;
+               ++m_queuedTasks;
+            }
+         }
+         if(!runFirst) {
+            return;
+         }
+
+         m_reactor->dispatch(events[0].data.fd, events[0].events);
+         --m_runningTasks;
+      }
+#endif
+
+      template<typename Job>
+      inline void queueJob(Job&& job) {
+         throwIfShutdown();
+
+         QueueDomain& domain = *m_queueDomains[submitDomain()];
+         {
+            std::scoped_lock lock{ domain.mutex };
+            domain.queue.emplace(std::forward<Job>(job), m_memoryResource);
+            ++domain.size;
+            ++m_queuedTasks;
+         }
+         startWorkerOnDemand();
+      }
+
+      inline void throwIfShutdown() {
+         if(!m_acceptingJobs) {
+            throw std::runtime_error("Attempted to queue a job, but the thread pool was shutdown. Call reset before queuing jobs.");
+         }
+      }
+
+      // Runs job once for each of the count elements starting at the random access iterator first, which stay valid for the whole batch. Each queued job only holds a
+      // pointer and an iterator, small enough for Task to store inline, and completion is tracked by one latch instead of a promise per job, so the batch makes no
+      // per-job allocations.
+      template<typename Job, typename Iterator>
+      inline void runBatch(Job& job, Iterator first, std::size_t count) {
+         if(count == 0) {
+            return;
+         }
+
+         struct Batch {
+            Job&       job;
+            std::latch done;
+         } batch{ job, std::latch{ static_cast<std::ptrdiff_t>(count) } };
+
+         // The batch is split into one contiguous chunk per domain with workers, so neighbouring items are run from the same cache.
+         throwIfShutdown();
+         const std::size_t domainCount = m_activeDomains.load(std::memory_order_relaxed);
+         const std::size_t chunkSize   = (count + domainCount - 1) / domainCount;
+         const std::size_t firstDomain = submitDomain();
+         for(std::size_t chunk = 0, begin = 0; begin < count; ++chunk, begin += chunkSize) {
+            QueueDomain&      domain = *m_queueDomains[(firstDomain + chunk) % domainCount];
+            const std::size_t end    = std::min(begin + chunkSize, count);
+
+            std::scoped_lock lock{ domain.mutex };
+            domain.queue.reserve(domain.queue.size() + (end - begin));
+            for(std::size_t i = begin; i < end; ++i) {
+               domain.queue.emplace(
+                   [context = &batch, element = first + static_cast<std::iter_difference_t<Iterator>>(i)] {
+                      context->job(*element);
+                      context->done.count_down();
+                   },
+                   m_memoryResource);
+            }
+            domain.size += end - begin;
+            m_queuedTasks += end - begin;
+         }
+         for(std::size_t i = 0; i < count; ++i) {
+            if(m_workersToStart.load(std::memory_order_relaxed) == 0) {
+               break;
+            }
+            startWorkerOnDemand();
+         }
+         batch.done.wait();
+      }
+
+      template<typename Job>
+      inline void queueBlockingJob(Job&& job) {
+         std::scoped_lock lock{ m_blockingMutex };
+         if(!m_blockingAccepting) {
+            throw std::runtime_error("Attempted to queue a blocking job, but the thread pool was shutdown. Call reset before queuing jobs.");
+         }
+
+         m_blockingQueue.emplace(std::forward<Job>(job), m_memoryResource);
+         if(m_blockingQueue.size() > m_idleBlockingThreads && m_blockingThreadCount < m_maxBlockingThreads) {
+            spawnBlockingThread();
+         }
+         else {
+            m_blockingCv.notify_one();
+         }
+      }
+
+      // Requires m_blockingMutex.
+      inline void spawnBlockingThread() {
+         std::erase_if(m_blockingThreads, [](BlockingThread& blockingThread) {
+            if(blockingThread.finished) {
+               blockingThread.thread.join();
+            }
+            return blockingThread.finished;
+         });
+
+         ++m_blockingThreadCount;
+         auto& blockingThread  = m_blockingThreads.emplace_back();
+         blockingThread.thread = detail::Thread{ m_threadOptions.stackSize, [this, &blockingThread] { blockingExecutor(blockingThread); } };
+      }
+
+      inline void blockingExecutor(BlockingThread& self) {
+#if defined(__linux__)
+         static_cast<void>(applyWorkerScheduling());
+#endif
+         Task             currentJob;
+         std::unique_lock lock{ m_blockingMutex };
+         while(true) {
+            ++m_idleBlockingThreads;
+            bool woken = m_blockingCv.wait_for(lock, m_blockingKeepAlive, [this] { return !m_blockingQueue.empty() || m_blockingStop; });
+            --m_idleBlockingThreads;
+
+            if(m_blockingQueue.empty()) {
+               if(m_blockingStop || !woken) {
+                  break;
+               }
+               continue;
+            }
+
+            currentJob = std::move(m_blockingQueue.front());
+            m_blockingQueue.pop();
+            ++m_runningBlockingTasks;
+            lock.unlock();
+
+            currentJob();
+            currentJob.reset();
+
+            lock.lock();
+            --m_runningBlockingTasks;
+            if(m_blockingQueue.empty() && m_runningBlockingTasks == 0) {
+               m_blockingDoneCv.notify_all();
+            }
+         }
+
+         --m_blockingThreadCount;
+         self.finished = true;
+      }
+
+      inline void finishBlockingJobsImpl() {
+         std::unique_lock lock{ m_blockingMutex };
+         m_blockingDoneCv.wait(lock, [this] { return m_blockingQueue.empty() && m_runningBlockingTasks == 0; });
+      }
+
+      inline void stopBlockingThreadsImpl() {
+         {
+            std::unique_lock lock{ m_blockingMutex };
+            m_blockingAccepting = false;
+            m_blockingDoneCv.wait(lock, [this] { return m_blockingQueue.empty() && m_runningBlockingTasks == 0; });
+            m_blockingStop = true;
+            m_blockingCv.notify_all();
+         }
+
+         // Blocking threads only erase themselves from the list under the lock, so the list is stable once m_blockingStop is set.
+         for(auto& blockingThread: m_blockingThreads) {
+            if(blockingThread.thread.joinable()) {
+               blockingThread.thread.join();
+            }
+         }
+
+         std::scoped_lock lock{ m_blockingMutex };
+         m_blockingThreads.clear();
+         m_blockingStop = false;
+      }
+
+      inline void joinThreadsImpl() { m_threads.clear(); }
+
+      [[nodiscard]] inline std::unique_lock<std::mutex> finishAllJobsImpl() {
+         m_execute = true;
+         std::unique_lock lock{ m_jobQueueMutex };
+         while(true) {
+            m_cv.wait(lock, [this] { return m_runningTasks == 0 && m_queuedTasks == 0 && m_unsettledHedges == 0; });
+            if(lanesIdleImpl()) {
+               return lock;
+            }
+            // Lanes never take the pool mutex, so their pending counts are waited on directly with the lock released. Their jobs may have submitted to the pool in
+            // the meantime, so the pool is checked again afterwards.
+            awaitLanesImpl(lock);
+         }
+      }
+
+      template<typename Result, bool Memoized, typename Key, typename Job, typename... Args>
+      [[nodiscard]] inline std::shared_future<Result> submitKeyed(const Key& key, Job&& job, Args&&... args) {
+         using Entry = KeyedEntry<std::decay_t<Key>, Result>;
+
+         const void*       type   = &s_keyedEntryType<std::decay_t<Key>, Result, Memoized>;
+         const std::size_t hash   = std::hash<std::decay_t<Key>>{}(key);
+         KeyStripe&        stripe = keyStripe(hash);
+         std::unique_lock  lock{ stripe.mutex };
+         for(auto [entry, end] = stripe.entries.equal_range(hash); entry != end; ++entry) {
+            if(entry->second->type == type) {
+               if(auto& typed = static_cast<Entry&>(*entry->second); typed.key == key) {
+                  if(!typed.cached || std::chrono::steady_clock::now() < typed.expires) {
+                     typed.referenced = true;
+                     return typed.future;
+                  }
+                  eraseKeyed(stripe, &typed);
+                  break;
+               }
+            }
+         }
+
+         std::promise<Result>       promise{ std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>{ m_memoryResource } };
+         std::shared_future<Result> future = promise.get_future().share();
+         KeyedEntryPtr              owned{ std::pmr::polymorphic_allocator<Entry>{ m_memoryResource }.template new_object<Entry>(type, hash, m_memoryResource, key, future) };
+         auto&                      entry  = *stripe.entries.emplace(hash, std::move(owned))->second;
+         lock.unlock();
+
+         try {
+            queueJob(KeyedJob<Result, BoundJobFor<Job, Args...>>{ std::move(promise), bindJob(std::forward<Job>(job), std::forward<Args>(args)...), this, &entry, Memoized });
+         }
+         catch(...) {
+            retireKeyed(&entry, false, [] {});
+            throw;
+         }
+         return future;
+      }
+
+      // The stripes are only allocated by the first keyed submission, pools that never use one do not pay for them. A deque, as stripes hold a mutex and cannot move.
+      [[nodiscard]] inline std::pmr::deque<KeyStripe>& keyStripes() {
+         std::call_once(m_keyStripesCreated, [this] {
+            for(std::size_t i = 0; i < KEY_STRIPE_COUNT; ++i) {
+               m_keyStripes.emplace_back(m_memoryResource);
+            }
+         });
+         return m_keyStripes;
+      }
+
+      [[nodiscard]] inline KeyStripe& keyStripe(std::size_t hash) { return keyStripes()[(hash ^ (hash >> 17)) % KEY_STRIPE_COUNT]; }
+
+      [[nodiscard]] inline std::size_t stripeCacheCapacity() const noexcept { return (m_resultCacheCapacity + KEY_STRIPE_COUNT - 1) / KEY_STRIPE_COUNT; }
+
+      // Publishes under the stripe's mutex, then caches the entry if asked to, or removes it from the map.
+      template<typename Publish>
+      inline void retireKeyed(KeyedEntryBase* retired, bool cache, Publish&& publish) {
+         KeyStripe&       stripe = keyStripe(retired->hash);
+         std::scoped_lock lock{ stripe.mutex };
+         publish();
+
+         const std::size_t capacity = stripeCacheCapacity();
+         if(!cache || capacity == 0) {
+            eraseKeyed(stripe, retired);
+            return;
+         }
+
+         evictCached(stripe, capacity - 1);
+         const auto now      = std::chrono::steady_clock::now();
+         const auto ttl      = m_resultCacheTtl.load();
+         retired->cached     = true;
+         retired->referenced = false;
+         retired->expires    = ttl < std::chrono::steady_clock::time_point::max() - now ? now + ttl : std::chrono::steady_clock::time_point::max();
+         retired->clockSlot  = stripe.clock.size();
+         stripe.clock.push_back(retired);
+      }
+
+      // Requires the stripe's mutex. Sweeps the CLOCK hand until at most keep entries are cached, giving referenced entries that have not expired a second chance.
+      inline void evictCached(KeyStripe& stripe, std::size_t keep) {
+         const auto now = std::chrono::steady_clock::now();
+         while(stripe.clock.size() > keep) {
+            stripe.hand %= stripe.clock.size();
+            if(KeyedEntryBase* entry = stripe.clock[stripe.hand]; entry->referenced && now < entry->expires) {
+               entry->referenced = false;
+               ++stripe.hand;
+            }
+            else {
+               eraseKeyed(stripe, entry);
+            }
+         }
+      }
+
+      // Requires the stripe's mutex.
+      inline void eraseKeyed(KeyStripe& stripe, KeyedEntryBase* erased) {
+         if(erased->cached) {
+            KeyedEntryBase* last            = stripe.clock.back();
+            stripe.clock[erased->clockSlot] = last;
+            last->clockSlot                 = erased->clockSlot;
+            stripe.clock.pop_back();
+         }
+         for(auto [entry, end] = stripe.entries.equal_range(erased->hash); entry != end; ++entry) {
+            if(entry->second.get() == erased) {
+               stripe.entries.erase(entry);
+               return;
+            }
+         }
+      }
+
+      template<typename Launch>
+      inline void scheduleHedge(std::chrono::steady_clock::time_point deadline, Launch&& launch) {
+         {
+            std::scoped_lock lock{ m_hedgeMutex };
+            if(!m_hedgeTimer.joinable()) {
+               m_hedgeTimer = detail::Thread{ m_threadOptions.stackSize, [this] { hedgeTimer(); } };
+            }
+            m_pendingHedges.push_back({ deadline, Task{ std::forward<Launch>(launch), m_memoryResource } });
+            std::ranges::push_heap(m_pendingHedges, std::ranges::greater{}, &PendingHedge::deadline);
+         }
+         m_hedgeCv.notify_one();
+      }
+
+      // Called once for each hedged submission, when its future is settled. The last one wakes finishAllJobs, which waits for them all.
+      inline void hedgeSettled() {
+         if(m_unsettledHedges.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::scoped_lock lock{ m_jobQueueMutex };
+            m_cv.notify_all();
+         }
+      }
+
+      // Launches each pending hedge once its deadline passes, earliest first.
+      inline void hedgeTimer() {
+         std::unique_lock lock{ m_hedgeMutex };
+         while(!m_stopHedges) {
+            if(m_pendingHedges.empty()) {
+               m_hedgeCv.wait(lock);
+               continue;
+            }
+            if(const auto deadline = m_pendingHedges.front().deadline; std::chrono::steady_clock::now() < deadline) {
+               m_hedgeCv.wait_until(lock, deadline);
+               continue;
+            }
+            std::ranges::pop_heap(m_pendingHedges, std::ranges::greater{}, &PendingHedge::deadline);
+            Task launch = std::move(m_pendingHedges.back().launch);
+            m_pendingHedges.pop_back();
+            lock.unlock();
+            launch();
+            lock.lock();
+         }
+      }
+
+      // Pending hedges are dropped; their first copies still run.
+      inline void stopHedgeTimerImpl() {
+         {
+            std::scoped_lock lock{ m_hedgeMutex };
+            m_stopHedges = true;
+         }
+         m_hedgeCv.notify_one();
+         m_hedgeTimer.join();
+         std::scoped_lock lock{ m_hedgeMutex };
+         m_pendingHedges.clear();
+         m_stopHedges = false;
+      }
+
+      [[nodiscard]] inline std::chrono::nanoseconds hedgeDelay(std::chrono::nanoseconds delay) {
+         std::scoped_lock lock{ m_hedgeMutex };
+         if(m_hedgePercentile == 0.0 || m_hedgeLatencyCount < MIN_HEDGE_LATENCIES) {
+            return delay;
+         }
+         std::array<std::chrono::nanoseconds, HEDGE_LATENCY_SAMPLES> latencies = m_hedgeLatencies;
+         const std::size_t observed = std::min(m_hedgeLatencyCount, HEDGE_LATENCY_SAMPLES);
+         const auto        rank     = static_cast<std::ptrdiff_t>(m_hedgePercentile / 100.0 * static_cast<double>(observed - 1));
+         std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.begin() + static_cast<std::ptrdiff_t>(observed));
+         return latencies[static_cast<std::size_t>(rank)];
+      }
+
+      inline void recordHedgeLatency(std::chrono::steady_clock::duration latency) {
+         std::scoped_lock lock{ m_hedgeMutex };
+         m_hedgeLatencies[m_hedgeLatencyCount++ % HEDGE_LATENCY_SAMPLES] = std::chrono::duration_cast<std::chrono::nanoseconds>(latency);
+      }
+
+      // Requires m_jobQueueMutex.
+      [[nodiscard]] inline bool lanesIdleImpl() const {
+#if defined(__linux__)
+         return std::ranges::all_of(m_lanes, [](const auto& lane) { return lane->m_pending.load(std::memory_order_acquire) == 0; });
+#else
+         return true;
+#endif
+      }
+
+      // Requires m_jobQueueMutex, which is released while waiting for every lane's queue to drain and held again on return.
+      inline void awaitLanesImpl([[maybe_unused]] std::unique_lock<std::mutex>& lock) {
+#if defined(__linux__)
+         std::pmr::vector<LowLatencyLane*> lanes{ m_memoryResource };
+         lanes.reserve(m_lanes.size());
+         for(const auto& lane: m_lanes) {
+            lanes.push_back(lane.get());
+         }
+         lock.unlock();
+         for(LowLatencyLane* lane: lanes) {
+            for(std::size_t pending = lane->m_pending.load(std::memory_order_acquire); pending != 0; pending = lane->m_pending.load(std::memory_order_acquire)) {
+               lane->m_pending.wait(pending, std::memory_order_acquire);
+            }
+         }
+         lock.lock();
+#endif
+      }
+
+      [[nodiscard]] inline std::unique_lock<std::mutex> shutdownImpl() {
+         m_execute = true;
+         m_pause   = false;
+         finishBlockingJobsImpl();
+         auto lock      = finishAllJobsImpl();
+         m_execute       = false;
+         m_acceptingJobs = false;
+         lock.unlock();
+         joinThreadsImpl();
+#if defined(__linux__)
+         stopLowLatencyLanesImpl();
+#endif
+         stopSpareThreadsImpl();
+         stopHedgeTimerImpl();
+         stopBlockingThreadsImpl();
+         lock.lock();
+         return lock;
+      }
+
+      inline void cleanUp() { auto _ = shutdownImpl(); }
+
+      [[nodiscard]] inline std::unique_lock<std::mutex> pauseImpl() {
+         m_pause = true;
+         // Workers check m_pause and count their job as running under the domain mutex, so once each one has been taken no worker can start a job it saw as unpaused.
+         for(auto& domain: m_queueDomains) {
+            std::scoped_lock domainLock{ domain->mutex };
+         }
+         std::unique_lock lock{ m_jobQueueMutex };
+         m_cv.wait(lock, [this] { return m_runningTasks == 0; });
+         return lock;
+      }
+
+     private:
+      friend class blockingRegion;
+      template<typename>
+      friend class CompletionQueue;
+
+      static constexpr std::size_t               DEFAULT_MAX_BLOCKING_THREADS  = 64;
+      static constexpr std::size_t               MAX_SPARE_THREADS             = 256;
+      static constexpr std::size_t               BATCH_ARENA_INLINE_SIZE       = 4096;
+      static constexpr std::size_t               DEFAULT_LANE_CAPACITY         = 1024;
+      static constexpr std::size_t               KEY_STRIPE_COUNT              = 64;
+      static constexpr std::size_t               DEFAULT_RESULT_CACHE_CAPACITY = 1024;
+      static constexpr std::size_t               HEDGE_LATENCY_SAMPLES         = 256;
+      static constexpr std::size_t               MIN_HEDGE_LATENCIES           = 32;
+
+      static inline thread_local TnTThreadPool* s_currentPool   = nullptr;
+      static inline thread_local CpuBudget*     s_heldCpuBudget  = nullptr;
+      static inline thread_local std::size_t    s_jobsOnCpuToken = 0;
+      static inline thread_local std::size_t    s_queueDomain    = 0;
+
+      static constexpr std::chrono::milliseconds CPU_TOKEN_WAIT{ 1 };
+
+      static constexpr std::chrono::milliseconds DEFAULT_BLOCKING_KEEP_ALIVE{ 10000 };
+
+      std::pmr::memory_resource*                m_memoryResource;
+      std::mutex                                m_jobQueueMutex;
+      ThreadOptions                             m_threadOptions;
+      std::vector<detail::Thread>               m_threads;
+      std::vector<std::unique_ptr<QueueDomain>> m_queueDomains;
+      std::vector<WorkerSlot>                   m_workerSlots;
+      WorkerPlacement                           m_placement{ WorkerPlacement::Default };
+      std::atomic_size_t                        m_activeDomains{ 1 };
+      std::atomic_size_t                        m_nextDomain{ 0 };
+
+      std::atomic_bool   m_execute{ true };
+      std::atomic_bool   m_acceptingJobs{ false };
+      std::atomic_size_t m_workersToStart{ 0 };
+      std::atomic_size_t m_startingWorkers{ 0 };
+      std::atomic_size_t m_idleWorkers{ 0 };
+      std::atomic_bool   m_pause{ false };
+      std::atomic_size_t m_runningTasks{ 0 };
+      std::atomic_size_t m_queuedTasks{ 0 };
+
+      std::size_t m_threadCount;
+
+      std::atomic<CpuBudget*> m_cpuBudget{ nullptr };
+
+      std::condition_variable m_cv;
+
+      std::mutex                        m_blockingMutex;
+      std::list<BlockingThread>         m_blockingThreads;
+      RingBuffer<Task>                  m_blockingQueue;
+      std::condition_variable           m_blockingCv;
+      std::condition_variable           m_blockingDoneCv;
+      std::size_t                       m_blockingThreadCount{ 0 };
+      std::size_t                       m_idleBlockingThreads{ 0 };
+      std::size_t                       m_runningBlockingTasks{ 0 };
+      std::size_t                       m_maxBlockingThreads{ DEFAULT_MAX_BLOCKING_THREADS };
+      std::chrono::milliseconds         m_blockingKeepAlive{ DEFAULT_BLOCKING_KEEP_ALIVE };
+      bool                              m_blockingAccepting{ false };
+      bool                              m_blockingStop{ false };
+
+      std::vector<detail::Thread> m_spareThreads;
+      std::condition_variable     m_spareCv;
+      std::atomic_size_t          m_blockedWorkers{ 0 };
+      std::atomic_size_t          m_activeSpares{ 0 };
+      std::size_t                 m_startingSpares{ 0 };
+      bool                        m_stopSpares{ false };
+
+      std::once_flag                                   m_keyStripesCreated;
+      std::pmr::deque<KeyStripe>                       m_keyStripes{ m_memoryResource };
+      std::atomic_size_t                               m_resultCacheCapacity{ DEFAULT_RESULT_CACHE_CAPACITY };
+      std::atomic<std::chrono::steady_clock::duration> m_resultCacheTtl{ std::chrono::steady_clock::duration::max() };
+
+      std::mutex                                                  m_hedgeMutex;
+      std::condition_variable                                     m_hedgeCv;
+      std::vector<PendingHedge>                                   m_pendingHedges;
+      bool                                                        m_stopHedges{ false };
+      double                                                      m_hedgePercentile{ 0.0 };
+      std::array<std::chrono::nanoseconds, HEDGE_LATENCY_SAMPLES> m_hedgeLatencies{};
+      std::size_t                                                 m_hedgeLatencyCount{ 0 };
+      std::atomic_size_t                                          m_unsettledHedges{ 0 };
+      detail::Thread                                              m_hedgeTimer;
+
+#if defined(__linux__)
+      std::vector<std::unique_ptr<LowLatencyLane>> m_lanes;
+
+      std::optional<WorkerScheduling> m_scheduling;
+      std::atomic_int                 m_schedulingError{ 0 };
+#endif
+
+#if defined(TNT_HAS_EPOLL)
+      std::unique_ptr<Reactor> m_reactor;
+      std::atomic_bool         m_reactorEnabled{ false };
+#endif
+   };
+
+   /// @brief Creates a job for each item in a container, passing the item as the only parameter to job.
+   /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+   /// @tparam Container A container of some sort, must be support a for each loop.
+   /// @param job The job to execute.
+   /// @param container The container to iterate over.
+   /// @remarks This function blocks until each job created from each container item is complete. Do NOT modify the container during this call. The job's parameter can be a non-const lvalue
+   /// reference to modify each element of a non-const container in place, however, the owning container should never be modified during this call. Every item is run by the same
+   /// job object, which may be called from several workers at once.
+   template<typename Job, typename Container>
+   static inline void forEach(Job&& job, Container&& container, std::size_t threadCount = defaultThreadCount()) {
+      TnTThreadPool threadPool{ threadCount };
+      threadPool.forEach(std::forward<Job>(job), std::forward<Container>(container));
+   }
+
+   /// @brief Creates N number of jobs where N is the number of times a number P can be incremented by @paramref increment from @paramref from to @paramref to.
+   /// @tparam Numeric A numeric value to increment from and to.
+   /// @tparam Job A callable of some type. I.e. lambda, function, or class/struct with operator() overloaded.
+   /// @param job The job to execute, taking one parameter of type @see Numeric.
+   /// @param from The starting value to increment from (inclusive).
+   /// @param to The ending value to increment to (exclusive).
+   /// @param increment [Optional; Default=1] The value to increment by for each job.
+   /// @remarks This function blocks until all submitted jobs have completed. Do NOT modify an containers that may be backing the stored data. The job should take one parameter whose type is
+   /// @see Numeric.
+   template<typename Numeric, typename Job>
+   static inline void forEachIndexed(Job&&       job,
+                                     Numeric     from,
+                                     Numeric     to,
                                      Numeric     increment   = 1,
-                                     std::size_t threadCount = static_cast<std::size_t>(std::thread::hardware_concurrency())) requires(std::is_arithmetic_v<Numeric>) {
+                                     std::size_t threadCount = defaultThreadCount()) requires(std::is_arithmetic_v<Numeric>) {
       TnTThreadPool threadPool{ threadCount };
-      threadPool.forEachIndexed(std::forward(job), from, to, increment, threadCount);
+      threadPool.forEachIndexed(std::forward<Job>(job), from, to, increment);
    }
 
+   /// @brief Marks the enclosing scope of a job as blocking. While a pool worker is inside a blocking region the pool wakes, or spawns, a spare worker so the number of
+   /// workers actually running jobs stays at the pool's thread count. The spare goes back to sleep once the region ends and its current job finishes.
+   /// @remarks Constructing a blocking region on a thread that is not a @see TnTThreadPool worker does nothing. A worker on a @see CpuBudget hands its token back for the
+   /// region and waits, without a timeout, for one to be free again when the region ends.
+   class blockingRegion {
+     public:
+      blockingRegion() : m_threadPool(TnTThreadPool::s_currentPool) {
+         if(m_threadPool != nullptr) {
+            m_cpuBudget = m_threadPool->beginBlocking();
+         }
+      }
+
+      ~blockingRegion() {
+         if(m_threadPool != nullptr) {
+            m_threadPool->endBlocking(m_cpuBudget);
+         }
+      }
+
+      blockingRegion(const blockingRegion&)            = delete;
+      blockingRegion& operator=(const blockingRegion&) = delete;
+
+     private:
+      TnTThreadPool* m_threadPool;
+      CpuBudget*     m_cpuBudget = nullptr;
+   };
+
+   /// @brief A queue of plain @see T items processed by one statically known @see Handler on the workers of a @see TnTThreadPool. Items are stored contiguously in a
+   /// ring buffer, not as one type-erased job each, and a few drain jobs move them out in batches, so the handler is called directly and can be inlined.
+   /// @tparam T The item type, must be move constructible.
+   /// @tparam Handler A callable taking either std::span<T>, to handle a whole batch at once, or T&, to be called once per item. Called from several workers concurrently.
+   /// @remarks The thread pool must outlive the queue. The destructor waits for every pushed item to be handled.
+   template<typename T, typename Handler>
+   class TypedWorkQueue {
+     public:
+      static constexpr bool HANDLES_BATCHES = std::is_invocable_v<Handler&, std::span<T>>;
+      static_assert(HANDLES_BATCHES || std::is_invocable_v<Handler&, T&>, "The handler must be callable with std::span<T> or T&.");
+
+      /// @param threadPool The pool whose workers run the handler.
+      /// @param handler [Optional; Default=Handler()] The handler.
+      /// @param batchSize [Optional; Default=256] The most items handed to the handler by one call, or handled by one drain job before it takes the next batch.
+      /// @param maxDrainers [Optional; Default=The pool's thread count] The most drain jobs the queue keeps in the pool at once.
+      explicit TypedWorkQueue(TnTThreadPool& threadPool, Handler handler = Handler(), std::size_t batchSize = DEFAULT_BATCH_SIZE, std::size_t maxDrainers = 0) :
+          m_threadPool(threadPool),
+          m_handler(std::move(handler)),
+          m_batchSize(std::max<std::size_t>(batchSize, 1)),
+          m_maxDrainers(maxDrainers != 0 ? maxDrainers : std::max<std::size_t>(threadPool.getThreadCount(), 1)),
+          m_items(threadPool.getMemoryResource()) {}
+
+      TypedWorkQueue(const TypedWorkQueue&)            = delete;
+      TypedWorkQueue& operator=(const TypedWorkQueue&) = delete;
+
+      ~TypedWorkQueue() {
+         std::unique_lock lock{ m_mutex };
+         m_idleCv.wait(lock, [this] { return m_items.empty() && m_activeDrainers == 0; });
+      }
+
+      /// @brief Queues one item.
+      template<typename... Args>
+      inline void emplace(Args&&... args) {
+         std::unique_lock lock{ m_mutex };
+         m_items.emplace(std::forward<Args>(args)...);
+         startDrainers(lock);
+      }
+
+      /// @brief Queues one item.
+      inline void push(T item) { emplace(std::move(item)); }
+
+      /// @brief Queues every item of @paramref items under one lock, which is much cheaper than pushing them one at a time.
+      template<std::ranges::input_range Range>
+      inline void pushRange(Range&& items) {
+         std::unique_lock lock{ m_mutex };
+         if constexpr(std::ranges::sized_range<Range>) {
+            m_items.reserve(m_items.size() + std::ranges::size(items));
+         }
+         for(auto&& item: items) {
+            m_items.emplace(std::forward<decltype(item)>(item));
+         }
+         startDrainers(lock);
+      }
+
+      /// @brief Waits until every item pushed so far has been handled.
+      /// @throws The first exception thrown by the handler since the last call, if any. Items in a batch whose handler threw are not handled again.
+      inline void wait() {
+         std::unique_lock lock{ m_mutex };
+         m_idleCv.wait(lock, [this] { return m_items.empty() && m_activeDrainers == 0; });
+         if(m_exception) {
+            std::rethrow_exception(std::exchange(m_exception, nullptr));
+         }
+      }
+
+      /// @brief Returns the number of items waiting to be handled.
+      [[nodiscard]] inline std::size_t size() {
+         std::scoped_lock lock{ m_mutex };
+         return m_items.size();
+      }
+
+     private:
+      static constexpr std::size_t DEFAULT_BATCH_SIZE = 256;
+
+      // Requires m_mutex, held by lock. A new drain job is only queued while there are more items than the running drain jobs will take in one batch each.
+      inline void startDrainers(std::unique_lock<std::mutex>& lock) {
+         std::size_t wanted = std::min(m_maxDrainers, (m_items.size() + m_batchSize - 1) / m_batchSize);
+         std::size_t start  = wanted > m_activeDrainers ? wanted - m_activeDrainers : 0;
+         m_activeDrainers += start;
+         lock.unlock();
+         for(std::size_t i = 0; i < start; ++i) {
+            try {
+               m_threadPool.submit([this] { drain(); });
+            }
+            catch(...) {
+               lock.lock();
+               m_activeDrainers -= start - i;
+               m_idleCv.notify_all();
+               throw;
+            }
+         }
+      }
+
+      inline void drain() {
+         std::pmr::vector<T> batch{ m_threadPool.getMemoryResource() };
+         batch.reserve(m_batchSize);
+
+         std::unique_lock lock{ m_mutex };
+         while(!m_items.empty()) {
+            while(!m_items.empty() && batch.size() < m_batchSize) {
+               batch.push_back(std::move(m_items.front()));
+               m_items.pop();
+            }
+            lock.unlock();
+
+            try {
+               if constexpr(HANDLES_BATCHES) {
+                  m_handler(std::span<T>{ batch });
+               }
+               else {
+                  for(auto& item: batch) {
+                     m_handler(item);
+                  }
+               }
+            }
+            catch(...) {
+               std::scoped_lock exceptionLock{ m_mutex };
+               if(!m_exception) {
+                  m_exception = std::current_exception();
+               }
+            }
+            batch.clear();
+
+            lock.lock();
+         }
+         --m_activeDrainers;
+         if(m_activeDrainers == 0) {
+            m_idleCv.notify_all();
+         }
+      }
+
+      TnTThreadPool&                m_threadPool;
+      [[no_unique_address]] Handler m_handler;
+      std::size_t                   m_batchSize;
+      std::size_t                   m_maxDrainers;
+
+      std::mutex              m_mutex;
+      std::condition_variable m_idleCv;
+      RingBuffer<T>           m_items;
+      std::size_t             m_activeDrainers{ 0 };
+      std::exception_ptr      m_exception;
+   };
+
+   /// @brief Accumulates individually submitted items into batches and hands each batch to @see Handler as one job on a @see TnTThreadPool. A batch is dispatched once it
+   /// holds maxBatchSize items or its first item has waited maxDelay, trading a bounded amount of latency for the throughput of handling items in bulk.
+   /// @tparam T The item type, must be move constructible.
+   /// @tparam Handler A callable taking std::span<T>. Batches may be handled concurrently.
+   /// @remarks The thread pool must outlive the batcher. The destructor dispatches the last partial batch and waits for every batch to be handled.
+   template<typename T, typename Handler>
+   class MicroBatcher {
+     public:
+      static_assert(std::is_invocable_v<Handler&, std::span<T>>, "The handler must be callable with std::span<T>.");
+
+      /// @param threadPool The pool whose workers run the handler.
+      /// @param handler The batch handler.
+      /// @param maxBatchSize The number of items that dispatches a batch straight away.
+      /// @param maxDelay The longest the first item of a batch waits before the batch is dispatched regardless of its size.
+      MicroBatcher(TnTThreadPool& threadPool, Handler handler, std::size_t maxBatchSize, std::chrono::microseconds maxDelay) :
+          m_threadPool(threadPool),
+          m_handler(std::move(handler)),
+          m_maxBatchSize(std::max<std::size_t>(maxBatchSize, 1)),
+          m_maxDelay(maxDelay),
+          m_batch(threadPool.getMemoryResource()),
+          m_flusher(threadPool.getThreadOptions().stackSize, std::bind(&MicroBatcher::flusher, this)) {}
+
+      MicroBatcher(const MicroBatcher&)            = delete;
+      MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+      ~MicroBatcher() {
+         {
+            std::scoped_lock lock{ m_mutex };
+            m_stop = true;
+         }
+         m_flushCv.notify_one();
+         m_flusher.join();
+
+         std::unique_lock lock{ m_mutex };
+         if(!m_batch.empty()) {
+            try {
+               dispatchImpl(lock);
+            }
+            catch(...) {
+               // The pool was shut down, the last batch can not be handled.
+            }
+            lock.lock();
+         }
+         m_idleCv.wait(lock, [this] { return m_inFlight == 0; });
+      }
+
+      /// @brief Adds one item to the current batch, dispatching the batch if it is now full.
+      template<typename... Args>
+      inline void emplace(Args&&... args) {
+         std::unique_lock lock{ m_mutex };
+         if(m_batch.empty()) {
+            m_batch.reserve(m_maxBatchSize);
+            m_deadline = std::chrono::steady_clock::now() + m_maxDelay;
+            m_flushCv.notify_one();
+         }
+         m_batch.emplace_back(std::forward<Args>(args)...);
+         if(m_batch.size() >= m_maxBatchSize) {
+            dispatchImpl(lock);
+         }
+      }
+
+      /// @brief Adds one item to the current batch, dispatching the batch if it is now full.
+      inline void submit(T item) { emplace(std::move(item)); }
+
+      /// @brief Dispatches the current batch now, however small.
+      inline void flush() {
+         std::unique_lock lock{ m_mutex };
+         if(!m_batch.empty()) {
+            dispatchImpl(lock);
+         }
+      }
+
+      /// @brief Flushes the current batch and waits until every dispatched batch has been handled.
+      /// @throws The first exception thrown by the handler since the last call, if any.
+      inline void wait() {
+         flush();
+         std::unique_lock lock{ m_mutex };
+         m_idleCv.wait(lock, [this] { return m_inFlight == 0; });
+         if(m_exception) {
+            std::rethrow_exception(std::exchange(m_exception, nullptr));
+         }
+      }
+
+     private:
+      // Requires m_mutex, held by lock, and returns with it released. The batch is moved into the job, which only holds it and this, so the job is stored inline.
+      inline void dispatchImpl(std::unique_lock<std::mutex>& lock) {
+         std::pmr::vector<T> batch{ std::move(m_batch) };
+         m_batch = std::pmr::vector<T>{ m_threadPool.getMemoryResource() };
+         ++m_generation;
+         ++m_inFlight;
+         lock.unlock();
+
+         try {
+            m_threadPool.submit([this, batch = std::move(batch)]() mutable { handle(batch); });
+         }
+         catch(...) {
+            lock.lock();
+            --m_inFlight;
+            m_idleCv.notify_all();
+            lock.unlock();
+            throw;
+         }
+      }
+
+      inline void handle(std::pmr::vector<T>& batch) {
+         std::exception_ptr exception;
+         try {
+            m_handler(std::span<T>{ batch });
+         }
+         catch(...) {
+            exception = std::current_exception();
+         }
+
+         std::scoped_lock lock{ m_mutex };
+         if(exception && !m_exception) {
+            m_exception = exception;
+         }
+         if(--m_inFlight == 0) {
+            m_idleCv.notify_all();
+         }
+      }
+
+      // Sleeps until the current batch's deadline and dispatches it, unless it was dispatched first for being full or by a flush.
+      inline void flusher() {
+         std::unique_lock lock{ m_mutex };
+         while(!m_stop) {
+            if(m_batch.empty()) {
+               m_flushCv.wait(lock, [this] { return m_stop || !m_batch.empty(); });
+               continue;
+            }
+
+            const std::size_t generation = m_generation;
+            if(!m_flushCv.wait_until(lock, m_deadline, [this, generation] { return m_stop || m_generation != generation; })) {
+               std::exception_ptr exception;
+               try {
+                  dispatchImpl(lock);
+               }
+               catch(...) {
+                  exception = std::current_exception();
+               }
+               lock.lock();
+               if(exception && !m_exception) {
+                  m_exception = exception;
+               }
+            }
+         }
+      }
+
+      TnTThreadPool&            m_threadPool;
+      Handler                   m_handler;
+      std::size_t               m_maxBatchSize;
+      std::chrono::microseconds m_maxDelay;
+
+      std::mutex                            m_mutex;
+      std::condition_variable               m_flushCv;
+      std::condition_variable               m_idleCv;
+      std::pmr::vector<T>                   m_batch;
+      std::chrono::steady_clock::time_point m_deadline;
+      std::size_t                           m_generation{ 0 };
+      std::size_t                           m_inFlight{ 0 };
+      std::exception_ptr                    m_exception;
+      bool                                  m_stop{ false };
+      detail::Thread                        m_flusher;
+   };
+
+   /// @brief Runs jobs on a @see TnTThreadPool and hands their results back in the order the jobs finish, not the order they were submitted, so a slow job does
+   /// not hold up handling the fast ones behind it.
+   /// @tparam T The result type, must be move constructible. Every job's return value must convert to it.
+   /// @remarks The thread pool must outlive the queue. The destructor waits for every submitted job to finish.
+   template<typename T>
+   class CompletionQueue {
+     public:
+      /// @param threadPool The pool whose workers run the jobs.
+      explicit CompletionQueue(TnTThreadPool& threadPool) : m_threadPool(threadPool), m_completed(threadPool.getMemoryResource()) {}
+
+      CompletionQueue(const CompletionQueue&)            = delete;
+      CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+      ~CompletionQueue() {
+         std::unique_lock lock{ m_mutex };
+         m_completedCv.wait(lock, [this] { return m_pending == 0; });
+      }
+
+      /// @brief Submits a job whose result is queued once it finishes.
+      /// @param job The job to execute.
+      /// @param args Arguments to provide to the job. Arguments are stored by value; wrap one in std::ref or std::cref to pass it by reference.
+      template<typename Job, typename... Args>
+      inline void submit(Job&& job, Args&&... args) {
+         TnTThreadPool::assertInvocable<Job, Args...>();
+         static_assert(std::is_convertible_v<TnTThreadPool::JobResult<DeduceReturnValue, Job, Args...>, T>,
+                       "The job's return value must convert to the completion queue's result type.");
+         {
+            std::scoped_lock lock{ m_mutex };
+            ++m_pending;
+         }
+         try {
+            m_threadPool.submit([this, bound = TnTThreadPool::bindJob(std::forward<Job>(job), std::forward<Args>(args)...)]() mutable {
+               try {
+                  complete(Completion{ bound(), nullptr });
+               }
+               catch(...) {
+                  complete(Completion{ std::nullopt, std::current_exception() });
+               }
+            });
+         }
+         catch(...) {
+            std::scoped_lock lock{ m_mutex };
+            --m_pending;
+            m_completedCv.notify_all();
+            throw;
+         }
+      }
+
+      /// @brief Waits for the next job to finish and returns its result.
+      /// @throws The exception thrown by the job, if it threw.
+      /// @throws std::runtime_error If there is no job left to wait for.
+      [[nodiscard]] inline T pop() {
+         std::unique_lock lock{ m_mutex };
+         m_completedCv.wait(lock, [this] { return !m_completed.empty() || m_pending == 0; });
+         if(m_completed.empty()) {
+            throw std::runtime_error("Attempted to pop from a completion queue with no submitted jobs left.");
+         }
+         return takeImpl();
+      }
+
+      /// @brief Returns the result of a job that already finished, without waiting.
+      /// @returns The result, or std::nullopt if no finished job is waiting to be popped.
+      /// @throws The exception thrown by the job, if it threw.
+      [[nodiscard]] inline std::optional<T> tryPop() {
+         std::scoped_lock lock{ m_mutex };
+         if(m_completed.empty()) {
+            return std::nullopt;
+         }
+         return takeImpl();
+      }
+
+      /// @brief Waits for at least one job to finish, then moves the results of up to @paramref maxCount finished jobs into @paramref results under one lock.
+      /// @returns The number of results appended, 0 only if there is no job left to wait for.
+      /// @throws The exception thrown by the job, if the first job taken threw. A job that threw later in the batch ends it, and is rethrown by the next pop.
+      inline std::size_t popBatch(std::vector<T>& results, std::size_t maxCount) {
+         std::unique_lock lock{ m_mutex };
+         m_completedCv.wait(lock, [this] { return !m_completed.empty() || m_pending == 0; });
+         std::size_t taken = 0;
+         while(taken < maxCount && !m_completed.empty() && (taken == 0 || !m_completed.front().exception)) {
+            results.push_back(takeImpl());
+            ++taken;
+         }
+         return taken;
+      }
+
+      /// @returns The number of submitted jobs that have not finished yet.
+      [[nodiscard]] inline std::size_t pending() {
+         std::scoped_lock lock{ m_mutex };
+         return m_pending;
+      }
+
+      /// @returns The number of finished jobs whose results have not been popped yet.
+      [[nodiscard]] inline std::size_t size() {
+         std::scoped_lock lock{ m_mutex };
+         return m_completed.size();
+      }
+
+     private:
+      struct Completion {
+         std::optional<T>   value;
+         std::exception_ptr exception;
+      };
+
+      // Notifies under m_mutex, so the destructor cannot return while the last job is still notifying.
+      inline void complete(Completion&& completion) {
+         std::scoped_lock lock{ m_mutex };
+         m_completed.emplace(std::move(completion));
+         --m_pending;
+         m_completedCv.notify_all();
+      }
+
+      // Requires m_mutex and a completed job.
+      [[nodiscard]] inline T takeImpl() {
+         Completion completion = std::move(m_completed.front());
+         m_completed.pop();
+         if(completion.exception) {
+            std::rethrow_exception(completion.exception);
+         }
+         return std::move(*completion.value);
+      }
+
+      TnTThreadPool& m_threadPool;
+
+      std::mutex              m_mutex;
+      std::condition_variable m_completedCv;
+      RingBuffer<Completion>  m_completed;
+      std::size_t             m_pending{ 0 };
+   };
+
+#if defined(TNT_HAS_IO_URING)
+   /// @brief Asynchronous file I/O backed by io_uring. Reads and writes are queued into the submission ring and handed to the kernel in batches, while a single reaper thread
+   /// blocks on the completion ring and dispatches each completion as a job onto the owning @see TnTThreadPool. Workers never block on the disk, so the pool can stay at
+   /// core count while the disk queue stays deep.
+   /// @remarks The thread pool must outlive this object. Requests are only handed to the kernel when @see submit is called or when the submission ring fills up. Once the
+   /// pool has been shut down, continuations run inline on the reaper thread instead, so every continuation still runs exactly once. The reaper runs with the pool's
+   /// @see ThreadOptions::stackSize.
+   class AsyncFileIO {
+     public:
+      /// @brief Creates the io_uring instance and starts the completion reaper.
+      /// @param threadPool The pool continuations are dispatched to.
+      /// @param queueDepth [Optional; Default=256] The number of submission ring entries. The kernel rounds this up to a power of two.
+      /// @throws std::system_error if the kernel does not support io_uring or the rings could not be mapped.
+      AsyncFileIO(TnTThreadPool& threadPool, std::uint32_t queueDepth = 256) : m_threadPool(threadPool) {
+         io_uring_params params{};
+         m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+         if(m_ringFd < 0) {
+            throw std::system_error(errno, std::system_category(), "io_uring_setup failed");
+         }
+
+         m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+         m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+         m_sqesSize   = params.sq_entries * sizeof(io_uring_sqe);
+         if(params.features & IORING_FEAT_SINGLE_MMAP) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+         }
+
+         try {
+            m_sqRing = mapRing(m_sqRingSize, IORING_OFF_SQ_RING);
+            m_cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? m_sqRing : mapRing(m_cqRingSize, IORING_OFF_CQ_RING);
+            m_sqes   = static_cast<io_uring_sqe*>(mapRing(m_sqesSize, IORING_OFF_SQES));
+         }
+         catch(...) {
+            releaseRing();
+            throw;
+         }
+
+         auto* sq      = static_cast<std::uint8_t*>(m_sqRing);
+         m_sqHead      = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.head);
+         m_sqTail      = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.tail);
+         m_sqMask      = *reinterpret_cast<std::uint32_t*>(sq + params.sq_off.ring_mask);
+         m_sqArray     = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.array);
+         m_sqEntries   = params.sq_entries;
+
+         auto* cq = static_cast<std::uint8_t*>(m_cqRing);
+         m_cqHead = reinterpret_cast<std::uint32_t*>(cq + params.cq_off.head);
+         m_cqTail = reinterpret_cast<std::uint32_t*>(cq + params.cq_off.tail);
+         m_cqMask = *reinterpret_cast<std::uint32_t*>(cq + params.cq_off.ring_mask);
+         m_cqes   = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+         m_reaper = detail::Thread{ threadPool.getThreadOptions().stackSize, std::bind(&AsyncFileIO::reaper, this) };
+      }
+
+      AsyncFileIO(const AsyncFileIO&)            = delete;
+      AsyncFileIO& operator=(const AsyncFileIO&) = delete;
+
+      /// @brief Submits any queued requests, waits for every outstanding request to complete and its continuation to run, then tears down the rings.
+      ~AsyncFileIO() {
+         {
+            std::scoped_lock lock{ m_submitMutex };
+            // Drain so the stop marker only completes after every request queued before it.
+            queueRequest(IORING_OP_NOP, -1, nullptr, 0, 0, nullptr, IOSQE_IO_DRAIN);
+            flushImpl();
+         }
+         m_reaper.join();
+         {
+            std::unique_lock lock{ m_completionMutex };
+            m_completionCv.wait(lock, [this] { return m_runningContinuations == 0; });
+         }
+         releaseRing();
+      }
+
+      /// @brief Queues a read of @paramref size bytes from @paramref fd at @paramref offset into @paramref buffer.
+      /// @tparam Continuation A callable taking one std::int32_t, the number of bytes read or a negated errno value.
+      /// @param continuation Submitted to the thread pool once the read completes. If it throws, the exception is rethrown by the next @see submit.
+      /// @remarks @paramref buffer must stay valid until the continuation has run.
+      template<typename Continuation>
+      inline void read(int fd, void* buffer, std::uint32_t size, std::uint64_t offset, Continuation&& continuation) {
+         queue(IORING_OP_READ, fd, buffer, size, offset, std::forward<Continuation>(continuation));
+      }
+
+      /// @brief Queues a write of @paramref size bytes from @paramref buffer to @paramref fd at @paramref offset.
+      /// @tparam Continuation A callable taking one std::int32_t, the number of bytes written or a negated errno value.
+      /// @param continuation Submitted to the thread pool once the write completes. If it throws, the exception is rethrown by the next @see submit.
+      /// @remarks @paramref buffer must stay valid until the continuation has run.
+      template<typename Continuation>
+      inline void write(int fd, const void* buffer, std::uint32_t size, std::uint64_t offset, Continuation&& continuation) {
+         queue(IORING_OP_WRITE, fd, const_cast<void*>(buffer), size, offset, std::forward<Continuation>(continuation));
+      }
+
+      /// @brief Queues a read and returns a future holding the number of bytes read or a negated errno value.
+      [[nodiscard]] inline std::future<std::int32_t> readForResult(int fd, void* buffer, std::uint32_t size, std::uint64_t offset) {
+         return queueForResult(IORING_OP_READ, fd, buffer, size, offset);
+      }
+
+      /// @brief Queues a write and returns a future holding the number of bytes written or a negated errno value.
+      [[nodiscard]] inline std::future<std::int32_t> writeForResult(int fd, const void* buffer, std::uint32_t size, std::uint64_t offset) {
+         return queueForResult(IORING_OP_WRITE, fd, const_cast<void*>(buffer), size, offset);
+      }
+
+      /// @brief Hands every queued request to the kernel in a single system call.
+      /// @returns The number of requests submitted.
+      /// @throws The first exception thrown by a continuation since the last call, if any. The queued requests are submitted either way.
+      inline std::size_t submit() {
+         std::size_t submitted = 0;
+         {
+            std::scoped_lock lock{ m_submitMutex };
+            submitted = flushImpl();
+         }
+         std::scoped_lock lock{ m_completionMutex };
+         if(m_exception) {
+            std::rethrow_exception(std::exchange(m_exception, nullptr));
+         }
+         return submitted;
+      }
+
+     private:
+      // A request either has a continuation, which runs on the pool, or publishes its result through the promise straight from the reaper.
+      struct Request {
+         std::function<void(std::int32_t)> continuation;
+         std::promise<std::int32_t>        result;
+      };
+
+      [[nodiscard]] inline void* mapRing(std::size_t size, std::uint64_t offset) {
+         void* ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, static_cast<off_t>(offset));
+         if(ring == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "Failed to map io_uring ring");
+         }
+         return ring;
+      }
+
+      inline void releaseRing() {
+         if(m_sqes != nullptr) {
+            munmap(m_sqes, m_sqesSize);
+         }
+         if(m_cqRing != nullptr && m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+         }
+         if(m_sqRing != nullptr) {
+            munmap(m_sqRing, m_sqRingSize);
+         }
+         close(m_ringFd);
+      }
+
+      template<typename Continuation>
+      inline void queue(std::uint8_t opcode, int fd, void* buffer, std::uint32_t size, std::uint64_t offset, Continuation&& continuation) {
+         queue(opcode, fd, buffer, size, offset, std::unique_ptr<Request>{ new Request{ std::forward<Continuation>(continuation), {} } });
+      }
+
+      [[nodiscard]] inline std::future<std::int32_t> queueForResult(std::uint8_t opcode, int fd, void* buffer, std::uint32_t size, std::uint64_t offset) {
+         std::unique_ptr<Request> request{ new Request{} };
+         auto                     future = request->result.get_future();
+         queue(opcode, fd, buffer, size, offset, std::move(request));
+         return future;
+      }
+
+      // The ring only takes ownership of the request once its entry is written. If flushing a full ring throws first, the request is freed here instead of leaking.
+      inline void queue(std::uint8_t opcode, int fd, void* buffer, std::uint32_t size, std::uint64_t offset, std::unique_ptr<Request> request) {
+         std::scoped_lock lock{ m_submitMutex };
+         queueRequest(opcode, fd, buffer, size, offset, request.get(), 0);
+         request.release();
+      }
+
+      // Requires m_submitMutex. A null request marks the reaper's stop entry.
+      inline void queueRequest(std::uint8_t opcode, int fd, void* buffer, std::uint32_t size, std::uint64_t offset, Request* request, std::uint8_t flags) {
+         std::uint32_t tail = *m_sqTail;
+         while(tail - std::atomic_ref{ *m_sqHead }.load(std::memory_order_acquire) == m_sqEntries) {
+            flushImpl();
+         }
+
+         std::uint32_t index = tail & m_sqMask;
+         io_uring_sqe& sqe   = m_sqes[index];
+         sqe                 = {};
+         sqe.opcode          = opcode;
+         sqe.flags           = flags;
+         sqe.fd              = fd;
+         sqe.off             = offset;
+         sqe.addr            = reinterpret_cast<std::uint64_t>(buffer);
+         sqe.len             = size;
+         sqe.user_data       = reinterpret_cast<std::uint64_t>(request);
+         m_sqArray[index]    = index;
+
+         std::atomic_ref{ *m_sqTail }.store(tail + 1, std::memory_order_release);
+         ++m_pendingSubmissions;
+      }
+
+      // Requires m_submitMutex.
+      inline std::size_t flushImpl() {
+         std::size_t submitted = 0;
+         while(m_pendingSubmissions > 0) {
+            auto result = syscall(__NR_io_uring_enter, m_ringFd, m_pendingSubmissions, 0, 0, nullptr, 0);
+            if(result < 0) {
+               if(errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                  std::this_thread::yield();
+                  continue;
+               }
+               throw std::system_error(errno, std::system_category(), "io_uring_enter failed");
+            }
+            m_pendingSubmissions -= static_cast<std::uint32_t>(result);
+            submitted += static_cast<std::size_t>(result);
+         }
+         return submitted;
+      }
+
+      // Runs the request's continuation, or publishes its result, then frees it. An exception is kept for submit to rethrow, so it never escapes a worker or the reaper.
+      inline void complete(Request* request, std::int32_t result) noexcept {
+         std::unique_ptr<Request> owned{ request };
+         try {
+            if(owned->continuation) {
+               owned->continuation(result);
+            }
+            else {
+               owned->result.set_value(result);
+            }
+         }
+         catch(...) {
+            std::scoped_lock lock{ m_completionMutex };
+            if(!m_exception) {
+               m_exception = std::current_exception();
+            }
+         }
+      }
+
+      // Notifies under the lock, so the destructor cannot tear down the condition variable while a worker is still notifying it.
+      inline void continuationFinished() {
+         std::scoped_lock lock{ m_completionMutex };
+         --m_runningContinuations;
+         m_completionCv.notify_all();
+      }
+
+      inline void reaper() {
+         while(true) {
+            std::uint32_t head = *m_cqHead;
+            std::uint32_t tail = std::atomic_ref{ *m_cqTail }.load(std::memory_order_acquire);
+            if(head == tail) {
+               syscall(__NR_io_uring_enter, m_ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+               continue;
+            }
+
+            bool stop = false;
+            for(; head != tail; ++head) {
+               const io_uring_cqe& cqe     = m_cqes[head & m_cqMask];
+               auto*               request = reinterpret_cast<Request*>(cqe.user_data);
+               if(request == nullptr) {
+                  stop = true;
+                  continue;
+               }
+
+               const auto result = static_cast<std::int32_t>(cqe.res);
+               if(request->continuation) {
+                  // The job only holds the request, so a pool that rejects it, i.e. because it was shut down, leaves the continuation intact to be run inline.
+                  {
+                     std::scoped_lock lock{ m_completionMutex };
+                     ++m_runningContinuations;
+                  }
+                  try {
+                     m_threadPool.submit([this, request, result] {
+                        complete(request, result);
+                        continuationFinished();
+                     });
+                     continue;
+                  }
+                  catch(...) {
+                     continuationFinished();
+                  }
+               }
+               complete(request, result);
+            }
+            std::atomic_ref{ *m_cqHead }.store(head, std::memory_order_release);
+
+            if(stop) {
+               return;
+            }
+         }
+      }
+
+     private:
+      TnTThreadPool&          m_threadPool;
+      std::mutex              m_submitMutex;
+      std::mutex              m_completionMutex;
+      std::condition_variable m_completionCv;
+      std::exception_ptr      m_exception;
+      std::size_t             m_runningContinuations{ 0 };
+      detail::Thread          m_reaper;
+
+      int           m_ringFd{ -1 };
+      void*         m_sqRing{ nullptr };
+      void*         m_cqRing{ nullptr };
+      io_uring_sqe* m_sqes{ nullptr };
+      std::size_t   m_sqRingSize{ 0 };
+      std::size_t   m_cqRingSize{ 0 };
+      std::size_t   m_sqesSize{ 0 };
+
+      std::uint32_t* m_sqHead{ nullptr };
+      std::uint32_t* m_sqTail{ nullptr };
+      std::uint32_t* m_sqArray{ nullptr };
+      std::uint32_t  m_sqMask{ 0 };
+      std::uint32_t  m_sqEntries{ 0 };
+      std::uint32_t  m_pendingSubmissions{ 0 };
+
+      std::uint32_t* m_cqHead{ nullptr };
+      std::uint32_t* m_cqTail{ nullptr };
+      io_uring_cqe*  m_cqes{ nullptr };
+      std::uint32_t  m_cqMask{ 0 };
+   };
+#endif
+
 }   // namespace TnT
 
 #endif
@@ -1,11 +1,23 @@
 #include <TnTThreadPool.h>
 #include <array>
 #include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <forward_list>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <latch>
+#include <memory_resource>
 #include <numeric>
 #include <thread>
 
+#if defined(TNT_HAS_EPOLL)
+#   include <sys/ioctl.h>
+#   include <sys/socket.h>
+#   include <unistd.h>
+#endif
+
 using namespace std::chrono_literals;
 
 namespace Concurrency {
@@ -221,6 +233,70 @@ namespace Concurrency {
       ASSERT_EQ(initialValue * initialValue, type.i);
    }
 
+   struct CopyCounter {
+      static inline std::atomic_int copies{ 0 };
+
+      std::vector<int> payload;
+
+      explicit CopyCounter(std::size_t size) : payload(size, 1) {}
+      CopyCounter(const CopyCounter& other) : payload(other.payload) { ++copies; }
+      CopyCounter(CopyCounter&&) noexcept = default;
+      CopyCounter& operator=(const CopyCounter&) = delete;
+      CopyCounter& operator=(CopyCounter&&)      = delete;
+   };
+
+   TEST(Submit_WithArgs, RvalueArgumentsAreNeverCopied) {
+      CopyCounter::copies = 0;
+      std::atomic_size_t total{ 0 };
+      {
+         TnT::TnTThreadPool tp;
+         tp.submit([&total](CopyCounter counter) { total += counter.payload.size(); }, CopyCounter{ 1000 });
+         tp.submit([&total](const CopyCounter& counter) { total += counter.payload.size(); }, CopyCounter{ 1000 });
+         auto sum = tp.submitForReturn<std::size_t>([](CopyCounter counter) { return counter.payload.size(); }, CopyCounter{ 1000 });
+         total += sum.get();
+      }
+      ASSERT_EQ(3000u, total);
+      ASSERT_EQ(0, CopyCounter::copies);
+   }
+
+   TEST(Submit_WithArgs, LvalueArgumentsAreCopiedOnce) {
+      CopyCounter::copies = 0;
+      CopyCounter        counter{ 10 };
+      std::atomic_size_t total{ 0 };
+      {
+         TnT::TnTThreadPool tp;
+         tp.submit([&total](CopyCounter copy) { total += copy.payload.size(); }, counter);
+         auto waitable = tp.submitWaitable([&total](const CopyCounter& copy) { total += copy.payload.size(); }, counter);
+         waitable.wait();
+      }
+      ASSERT_EQ(20u, total);
+      ASSERT_EQ(2, CopyCounter::copies);
+   }
+
+   TEST(Submit_WithArgs, ReferenceWrapperArgumentsAreNotCopied) {
+      CopyCounter::copies = 0;
+      CopyCounter counter{ 10 };
+      int         value = 123;
+      {
+         TnT::TnTThreadPool tp;
+         tp.submit([](int& i) { i = i * i; }, std::ref(value));
+         auto size = tp.submitForReturn<std::size_t>([](const CopyCounter& c) { return c.payload.size(); }, std::cref(counter));
+         ASSERT_EQ(10u, size.get());
+      }
+      ASSERT_EQ(123 * 123, value);
+      ASSERT_EQ(0, CopyCounter::copies);
+   }
+
+   TEST(Submit_WithArgs, ReferenceWrapperIsUnwrappedForGenericJobs) {
+      std::vector<int> values{ 1, 2, 3 };
+
+      TnT::TnTThreadPool tp;
+      auto               waitable = tp.submitWaitable([](auto& container) { container.push_back(4); }, std::ref(values));
+      waitable.wait();
+
+      ASSERT_EQ(4u, values.size());
+   }
+
    ///* SubmitWaitable */
    TEST(SubmitWaitable, Lamda) {
       auto lambda = [] { std::this_thread::sleep_for(DEFAULT_STALL_TIME); };
@@ -415,6 +491,177 @@ namespace Concurrency {
       ASSERT_EQ(value * value, waitable.get());
    }
 
+   /* MemoryResource */
+   class CountingResource : public std::pmr::memory_resource {
+     public:
+      std::atomic_size_t allocations{ 0 };
+      std::atomic_size_t deallocations{ 0 };
+
+     private:
+      void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+         ++allocations;
+         return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+      }
+      void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+         ++deallocations;
+         std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+      }
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+   };
+
+   TEST(MemoryResource, QueueAndLargeJobsUseResource) {
+      CountingResource resource;
+      {
+         TnT::TnTThreadPool tp{ 2, &resource };
+         ASSERT_EQ(&resource, tp.getMemoryResource());
+
+         std::array<std::int64_t, 32> large{};
+         large.fill(3);
+         std::atomic<std::int64_t> sum{ 0 };
+         tp.submit([large, &sum] { sum += std::accumulate(large.begin(), large.end(), std::int64_t{ 0 }); });
+         tp.finishAllJobs();
+         ASSERT_EQ(96, sum);
+      }
+      ASSERT_GT(resource.allocations, 0u);
+      ASSERT_EQ(resource.allocations, resource.deallocations);
+   }
+
+   TEST(MemoryResource, PromiseStateUsesResource) {
+      CountingResource resource;
+      {
+         TnT::TnTThreadPool tp{ 1, &resource };
+         tp.submit([] {});
+         tp.finishAllJobs();
+
+         auto before   = resource.allocations.load();
+         auto waitable = tp.submitForReturn<int>(functionReturnValueWithArgs, 4);
+         ASSERT_EQ(16, waitable.get());
+         ASSERT_GT(resource.allocations.load(), before);
+      }
+      ASSERT_EQ(resource.allocations, resource.deallocations);
+   }
+
+   TEST(MemoryResource, KeyedEntriesUseResource) {
+      CountingResource resource;
+      {
+         TnT::TnTThreadPool tp{ 1, &resource };
+         ASSERT_EQ(0, tp.submitForReturnMemoized(0, [] { return 0; }).get());
+
+         auto before = resource.allocations.load();
+         ASSERT_EQ(1, tp.submitForReturn([] { return 1; }).get());
+         const auto plain = resource.allocations.load() - before;
+
+         before = resource.allocations.load();
+         ASSERT_EQ(2, tp.submitForReturnMemoized(2, [] { return 2; }).get());
+         // The entry and its map node come from the resource on top of the promise state.
+         ASSERT_GE(resource.allocations.load() - before, plain + 2);
+      }
+      ASSERT_EQ(resource.allocations, resource.deallocations);
+   }
+
+   TEST(MemoryResource, MoveOnlyJob) {
+      TnT::TnTThreadPool tp;
+
+      auto value  = std::make_unique<int>(42);
+      auto result = std::make_shared<std::promise<int>>();
+      tp.submit([value = std::move(value), result] { result->set_value(*value); });
+      ASSERT_EQ(42, result->get_future().get());
+   }
+
+   /* RingBuffer */
+   TEST(RingBuffer, KeepsOrderAcrossWrapAroundAndGrowth) {
+      TnT::RingBuffer<int> buffer;
+
+      int next     = 0;
+      int expected = 0;
+      for(auto round = 0; round < 10; ++round) {
+         for(auto i = 0; i < 50 + round * 40; ++i) {
+            buffer.emplace(next++);
+         }
+         for(auto i = 0; i < 30; ++i) {
+            ASSERT_EQ(expected++, buffer.front());
+            buffer.pop();
+         }
+      }
+      while(!buffer.empty()) {
+         ASSERT_EQ(expected++, buffer.front());
+         buffer.pop();
+      }
+      ASSERT_EQ(next, expected);
+   }
+
+   TEST(RingBuffer, RetainsCapacityByDefault) {
+      TnT::RingBuffer<std::unique_ptr<int>> buffer;
+      for(auto i = 0; i < 100000; ++i) {
+         buffer.emplace(std::make_unique<int>(i));
+      }
+      auto grown = buffer.capacity();
+      ASSERT_GE(grown, 100000u);
+
+      while(!buffer.empty()) {
+         buffer.pop();
+      }
+      ASSERT_EQ(grown, buffer.capacity());
+
+      buffer.shrinkToFit();
+      ASSERT_EQ(TnT::RingBuffer<int>::MINIMUM_CAPACITY, buffer.capacity());
+   }
+
+   TEST(RingBuffer, HalvesWhenQuarterFull) {
+      TnT::RingBuffer<int> buffer;
+      buffer.setShrinkPolicy(TnT::ShrinkPolicy::HalveWhenQuarterFull);
+      for(auto i = 0; i < 1024; ++i) {
+         buffer.emplace(i);
+      }
+      ASSERT_EQ(1024u, buffer.capacity());
+
+      for(auto i = 0; i < 1024 - 256; ++i) {
+         ASSERT_EQ(i, buffer.front());
+         buffer.pop();
+      }
+      ASSERT_EQ(512u, buffer.capacity());
+      ASSERT_EQ(768, buffer.front());
+   }
+
+   /* SubmitForReturn_Deduced */
+   TEST(SubmitForReturn_Deduced, DeducesReturnType) {
+      TnT::TnTThreadPool tp;
+
+      auto squared = tp.submitForReturn(functionReturnValueWithArgs, 12);
+      auto id      = tp.submitForReturn(CallableReturnValue{});
+      auto text    = tp.submitForReturn([](std::string prefix) { return prefix + "Pool"; }, std::string{ "TnT" });
+
+      static_assert(std::is_same_v<std::future<int>, decltype(squared)>);
+      static_assert(std::is_same_v<std::future<std::thread::id>, decltype(id)>);
+      static_assert(std::is_same_v<std::future<std::string>, decltype(text)>);
+
+      ASSERT_EQ(144, squared.get());
+      ASSERT_NE(MAIN_THREAD_ID, id.get());
+      ASSERT_EQ("TnTPool", text.get());
+   }
+
+   TEST(SubmitForReturn_Deduced, MoveOnlyResult) {
+      TnT::TnTThreadPool tp;
+
+      auto buffer = tp.submitForReturn([](std::size_t size) { return std::make_unique<std::vector<int>>(size, 7); }, std::size_t{ 1000 });
+      static_assert(std::is_same_v<std::future<std::unique_ptr<std::vector<int>>>, decltype(buffer)>);
+
+      auto result = buffer.get();
+      ASSERT_EQ(1000u, result->size());
+      ASSERT_EQ(7, result->back());
+   }
+
+   TEST(SubmitForReturn_Deduced, ReferenceResult) {
+      int                value = 5;
+      TnT::TnTThreadPool tp;
+
+      auto reference = tp.submitForReturn([](int& i) -> int& { return i; }, std::ref(value));
+      static_assert(std::is_same_v<std::future<int&>, decltype(reference)>);
+      reference.get() = 9;
+
+      ASSERT_EQ(9, value);
+   }
+
    /* Pause */
    TEST(Pause, PauseAndResume) {
       auto value  = 1;
@@ -517,6 +764,888 @@ namespace Concurrency {
       ASSERT_GT(DEFAULT_STALL_TIME * iterations, end - start);
    }
 
+   /* DefaultThreadCount */
+   TEST(DefaultThreadCount, WithinHardwareConcurrency) {
+      auto count = TnT::defaultThreadCount();
+      ASSERT_GE(count, 1u);
+      if(std::thread::hardware_concurrency() != 0) {
+         ASSERT_LE(count, static_cast<std::size_t>(std::thread::hardware_concurrency()));
+      }
+
+      TnT::TnTThreadPool tp;
+      ASSERT_EQ(count, tp.getThreadCount());
+      ASSERT_EQ(count, tp.refreshThreadCount());
+   }
+
+#if defined(__linux__)
+   TEST(DefaultThreadCount, ParsesCgroupQuotas) {
+      auto directory = std::filesystem::temp_directory_path() / "TnTThreadPoolCgroupTest";
+      std::filesystem::create_directories(directory);
+      auto write = [&directory](const char* name, const char* contents) { std::ofstream{ directory / name } << contents; };
+
+      ASSERT_FALSE(TnT::detail::readCgroupV2CpuLimit(directory.string()).has_value());
+      write("cpu.max", "max 100000\n");
+      ASSERT_FALSE(TnT::detail::readCgroupV2CpuLimit(directory.string()).has_value());
+      write("cpu.max", "400000 100000\n");
+      ASSERT_EQ(4u, TnT::detail::readCgroupV2CpuLimit(directory.string()));
+      write("cpu.max", "150000 100000\n");
+      ASSERT_EQ(2u, TnT::detail::readCgroupV2CpuLimit(directory.string()));
+      write("cpu.max", "unlimited 100000\n");
+      ASSERT_FALSE(TnT::detail::readCgroupV2CpuLimit(directory.string()).has_value());
+      write("cpu.max", "400000x 100000\n");
+      ASSERT_FALSE(TnT::detail::readCgroupV2CpuLimit(directory.string()).has_value());
+
+      write("cpu.cfs_period_us", "100000\n");
+      write("cpu.cfs_quota_us", "-1\n");
+      ASSERT_FALSE(TnT::detail::readCgroupV1CpuLimit(directory.string()).has_value());
+      write("cpu.cfs_quota_us", "300000\n");
+      ASSERT_EQ(3u, TnT::detail::readCgroupV1CpuLimit(directory.string()));
+
+      std::filesystem::remove_all(directory);
+   }
+#endif
+
+#if defined(__linux__)
+   /* Topology */
+   TEST(Topology, ParsesCpuLists) {
+      ASSERT_EQ((std::vector<int>{ 0, 1, 2, 3, 8, 10, 11 }), TnT::detail::parseCpuList("0-3,8,10-11\n"));
+      ASSERT_TRUE(TnT::detail::parseCpuList("").empty());
+   }
+
+   TEST(Topology, ReadsSmtLastLevelCacheAndNode) {
+      auto root  = std::filesystem::temp_directory_path() / "TnTThreadPoolTopologyTest";
+      auto write = [](const std::filesystem::path& path, const std::string& contents) {
+         std::filesystem::create_directories(path.parent_path());
+         std::ofstream{ path } << contents << '\n';
+      };
+
+      // Two nodes of four CPUs, two SMT siblings per core. Node 0 has one last level cache, node 1 has one per core.
+      write(root / "node/possible", "0-1");
+      write(root / "node/node0/cpulist", "0-3");
+      write(root / "node/node1/cpulist", "4-7");
+      for(int cpu = 0; cpu < 8; ++cpu) {
+         auto directory = root / ("cpu/cpu" + std::to_string(cpu));
+         auto siblings  = std::to_string(cpu & ~1) + "-" + std::to_string(cpu | 1);
+         write(directory / "topology/thread_siblings_list", siblings);
+         write(directory / "cache/index0/level", "1");
+         write(directory / "cache/index0/type", "Data");
+         write(directory / "cache/index0/shared_cpu_list", siblings);
+         write(directory / "cache/index1/level", "3");
+         write(directory / "cache/index1/type", "Unified");
+         write(directory / "cache/index1/shared_cpu_list", cpu < 4 ? "0-3" : siblings);
+      }
+
+      auto topology = TnT::detail::readCpuTopology({ 1, 2, 5, 6 }, root.string());
+      ASSERT_EQ(4u, topology.size());
+      ASSERT_EQ(1, topology[0].cpu);
+      ASSERT_EQ(0, topology[0].core);
+      ASSERT_EQ(0, topology[0].llc);
+      ASSERT_EQ(0, topology[0].node);
+      ASSERT_EQ(2, topology[1].core);
+      ASSERT_EQ(0, topology[1].llc);
+      ASSERT_EQ(4, topology[2].core);
+      ASSERT_EQ(4, topology[2].llc);
+      ASSERT_EQ(1, topology[2].node);
+      ASSERT_EQ(6, topology[3].llc);
+      ASSERT_EQ(1, topology[3].node);
+
+      // Without sysfs every CPU is its own core on one shared cache and node.
+      auto bare = TnT::detail::readCpuTopology({ 3 }, (root / "missing").string());
+      ASSERT_EQ(3, bare[0].core);
+      ASSERT_EQ(0, bare[0].llc);
+      ASSERT_EQ(0, bare[0].node);
+
+      std::filesystem::remove_all(root);
+   }
+
+   // Two last level caches on one node, so pools built while it is alive get two queue domains whatever the machine they run on.
+   struct TwoCacheTopology {
+      TwoCacheTopology() { TnT::detail::topologyOverride() = std::vector<TnT::detail::CpuLocation>{ { 0, 0, 0, 0 }, { 1, 1, 1, 0 } }; }
+      ~TwoCacheTopology() { TnT::detail::topologyOverride().reset(); }
+   };
+
+   TEST(Topology, WorkersStealFromOtherDomains) {
+      TwoCacheTopology   topology;
+      TnT::TnTThreadPool tp{ 2 };
+      ASSERT_EQ(2u, tp.getQueueDomainCount());
+
+      // Jobs submitted from a job stay on its worker's domain. The parent holds that worker until every child has run, so only the other domain's worker can run them.
+      constexpr int                childCount = 20;
+      std::atomic_int              ran{ 0 };
+      std::atomic<std::thread::id> childThread;
+
+      auto parent = tp.submitForReturn([&tp, &ran, &childThread] {
+         for(auto i = 0; i < childCount; ++i) {
+            tp.submit([&ran, &childThread] {
+               childThread = std::this_thread::get_id();
+               ++ran;
+            });
+         }
+         auto deadline = std::chrono::steady_clock::now() + DEFAULT_STALL_TIME * 50;
+         while(ran < childCount && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+         }
+         return std::make_pair(std::this_thread::get_id(), ran.load());
+      });
+
+      auto [parentThread, ranWhileParentRan] = parent.get();
+      ASSERT_EQ(childCount, ranWhileParentRan);
+      ASSERT_NE(parentThread, childThread.load());
+      tp.finishAllJobs();
+   }
+
+   TEST(Topology, PauseHoldsEveryDomain) {
+      TwoCacheTopology   topology;
+      TnT::TnTThreadPool tp{ 2 };
+
+      std::atomic_int counter{ 0 };
+      tp.pause();
+      for(auto i = 0; i < 20; ++i) {
+         tp.submit([&counter] { ++counter; });
+      }
+      std::this_thread::sleep_for(DEFAULT_STALL_TIME * 5);
+      ASSERT_EQ(0, counter);
+
+      tp.resume();
+      tp.finishAllJobs();
+      ASSERT_EQ(20, counter);
+   }
+#endif
+
+   /* WorkerPlacement */
+   TEST(WorkerPlacement, LogicalCpusPinsOneWorkerPerCpu) {
+      TnT::TnTThreadPool tp{ TnT::WorkerPlacement::LogicalCpus };
+      ASSERT_EQ(TnT::WorkerPlacement::LogicalCpus, tp.getWorkerPlacement());
+      ASSERT_EQ(TnT::defaultThreadCount(), tp.getThreadCount());
+
+#if defined(__linux__)
+      if(TnT::detail::affinityCpus().empty()) {
+         GTEST_SKIP() << "CPU topology unavailable, workers are left unpinned.";
+      }
+      auto allowed = tp.submitForReturn([] {
+         cpu_set_t cpuSet;
+         CPU_ZERO(&cpuSet);
+         sched_getaffinity(0, sizeof(cpuSet), &cpuSet);
+         return CPU_COUNT(&cpuSet);
+      });
+      ASSERT_EQ(1, allowed.get());
+#endif
+   }
+
+#if defined(__linux__)
+   TEST(WorkerPlacement, DefaultLeavesWorkersUnpinned) {
+      TwoCacheTopology   topology;
+      TnT::TnTThreadPool tp{ 2 };
+      ASSERT_EQ(TnT::WorkerPlacement::Default, tp.getWorkerPlacement());
+
+      auto allowed = tp.submitForReturn([] { return TnT::detail::affinityCpus(); });
+      ASSERT_EQ(TnT::detail::affinityCpus(), allowed.get());
+   }
+#endif
+
+   TEST(WorkerPlacement, PhysicalCoresRunsAtMostOneWorkerPerCore) {
+      TnT::TnTThreadPool tp{ TnT::WorkerPlacement::PhysicalCores };
+      ASSERT_GE(tp.getThreadCount(), 1u);
+      ASSERT_LE(tp.getThreadCount(), TnT::defaultThreadCount());
+
+      std::atomic_int counter{ 0 };
+      for(auto i = 0; i < 100; ++i) {
+         tp.submit([&counter] { ++counter; });
+      }
+      tp.finishAllJobs();
+      ASSERT_EQ(100, counter);
+   }
+
+#if defined(__linux__)
+   /* LowLatencyLane */
+   TEST(LowLatencyLane, RunsJobsFromManyProducersOnItsCpu) {
+      int cpu = TnT::detail::affinityCpus().front();
+
+      TnT::TnTThreadPool tp{ 2 };
+      auto&              lane = tp.addLowLatencyWorker(cpu, 0, 64);
+      ASSERT_EQ(cpu, lane.getCpu());
+
+      std::atomic_int counter{ 0 };
+      std::atomic_int wrongCpu{ 0 };
+      auto            producer = [&lane, &counter, &wrongCpu, cpu] {
+         for(auto i = 0; i < 500; ++i) {
+            lane.submit([&counter, &wrongCpu, cpu](int increment) {
+               counter += increment;
+               if(sched_getcpu() != cpu) {
+                  ++wrongCpu;
+               }
+            }, 1);
+         }
+      };
+      std::jthread first{ producer };
+      std::jthread second{ producer };
+      first.join();
+      second.join();
+
+      tp.finishAllJobs();
+      ASSERT_EQ(1000, counter);
+      ASSERT_EQ(0, wrongCpu);
+   }
+
+   TEST(LowLatencyLane, FinishAllJobsWaitsForJobsPassedBetweenLaneAndPool) {
+      TnT::TnTThreadPool tp{ 1 };
+      auto&              lane = tp.addLowLatencyWorker(TnT::detail::affinityCpus().front());
+
+      std::atomic_int counter{ 0 };
+      tp.submit([&tp, &lane, &counter] {
+         lane.submit([&tp, &counter] {
+            std::this_thread::sleep_for(DEFAULT_STALL_TIME);
+            tp.submit([&counter] {
+               std::this_thread::sleep_for(DEFAULT_STALL_TIME);
+               ++counter;
+            });
+         });
+      });
+      tp.finishAllJobs();
+      ASSERT_EQ(1, counter);
+   }
+
+   TEST(LowLatencyLane, UsesThePoolsStackSize) {
+      constexpr std::size_t STACK_SIZE = 256 * 1024;
+      TnT::TnTThreadPool    tp{ 1, TnT::ThreadOptions{ .stackSize = STACK_SIZE, .prefaultStack = 64 * 1024 } };
+      auto&                 lane = tp.addLowLatencyWorker(TnT::detail::affinityCpus().front());
+
+      std::promise<std::size_t> stackSize;
+      lane.submit([&stackSize] {
+         pthread_attr_t attributes;
+         std::size_t    size = 0;
+         pthread_getattr_np(pthread_self(), &attributes);
+         pthread_attr_getstacksize(&attributes, &size);
+         pthread_attr_destroy(&attributes);
+         stackSize.set_value(size);
+      });
+      const std::size_t size = stackSize.get_future().get();
+      ASSERT_GE(size, STACK_SIZE);
+      ASSERT_LT(size, 2 * STACK_SIZE);
+   }
+
+   TEST(LowLatencyLane, ThrowsForInvalidCpu) {
+      TnT::TnTThreadPool tp{ 1 };
+      ASSERT_THROW(tp.addLowLatencyWorker(-1), std::system_error);
+      ASSERT_THROW(tp.addLowLatencyWorker(CPU_SETSIZE * 64), std::system_error);
+
+      std::atomic_int counter{ 0 };
+      tp.submit([&counter] { ++counter; });
+      tp.finishAllJobs();
+      ASSERT_EQ(1, counter);
+   }
+#endif
+
+#if defined(__linux__)
+   /* WorkerScheduling */
+   TEST(WorkerScheduling, AppliedToEveryWorker) {
+      TnT::TnTThreadPool tp{ 3 };
+      ASSERT_FALSE(tp.getWorkerScheduling().has_value());
+
+      auto check = [&tp](int policy, int nice) {
+         std::atomic_int mismatches{ 0 };
+         for(auto i = 0; i < 30; ++i) {
+            tp.submit([&mismatches, policy, nice] {
+               if(sched_getscheduler(0) != policy || getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid))) != nice) {
+                  ++mismatches;
+               }
+               std::this_thread::sleep_for(std::chrono::microseconds(100));
+            });
+         }
+         tp.finishAllJobs();
+         return mismatches.load();
+      };
+
+      tp.setWorkerScheduling({ TnT::SchedulingPolicy::Batch, 5 });
+      ASSERT_EQ(3u, tp.getThreadCount());
+      ASSERT_EQ(0, check(SCHED_BATCH, 5));
+
+      tp.setWorkerScheduling({ TnT::SchedulingPolicy::Idle });
+      ASSERT_EQ(TnT::SchedulingPolicy::Idle, tp.getWorkerScheduling()->policy);
+      ASSERT_EQ(0, check(SCHED_IDLE, 0));
+   }
+
+   TEST(WorkerScheduling, PausedPoolStaysPaused) {
+      TnT::TnTThreadPool tp{ 2 };
+      tp.pause();
+      std::atomic_int counter{ 0 };
+      tp.submit([&counter] { ++counter; });
+
+      tp.setWorkerScheduling({ TnT::SchedulingPolicy::Batch });
+      std::this_thread::sleep_for(DEFAULT_STALL_TIME);
+      ASSERT_EQ(0, counter);
+
+      tp.resume();
+      tp.finishAllJobs();
+      ASSERT_EQ(1, counter);
+   }
+#endif
+
+   /* ThreadOptions */
+   TEST(ThreadOptions, LazyStartSpawnsWorkersAsWorkAppears) {
+      TnT::TnTThreadPool tp{ 4, TnT::ThreadOptions{ .lazyStart = true } };
+      ASSERT_EQ(0u, tp.getThreadCount());
+      tp.finishAllJobs();
+
+      auto first = tp.submitForReturn([] { return 7; });
+      ASSERT_EQ(7, first.get());
+      ASSERT_GE(tp.getThreadCount(), 1u);
+
+      std::atomic_int counter{ 0 };
+      for(auto i = 0; i < 50; ++i) {
+         tp.submit([&counter] {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            ++counter;
+         });
+      }
+      tp.finishAllJobs();
+      ASSERT_EQ(50, counter);
+      ASSERT_LE(tp.getThreadCount(), 4u);
+
+      tp.setThreadCount(2);
+      ASSERT_LE(tp.getThreadCount(), 2u);
+      ASSERT_EQ(3, tp.submitForReturn([] { return 3; }).get());
+   }
+
+   TEST(ThreadOptions, TreeStartReturnsWithEveryWorkerWarmedUp) {
+      std::mutex               mutex;
+      std::vector<std::size_t> warmed;
+
+      TnT::ThreadOptions options;
+      options.treeStart     = true;
+      options.stackSize     = 256 * 1024;
+      options.prefaultStack = 64 * 1024;
+      options.warmUp        = [&mutex, &warmed](std::size_t index) {
+         std::scoped_lock lock{ mutex };
+         warmed.push_back(index);
+      };
+
+      TnT::TnTThreadPool tp{ 13, options };
+      {
+         std::scoped_lock lock{ mutex };
+         std::ranges::sort(warmed);
+         ASSERT_EQ(13u, warmed.size());
+         for(std::size_t i = 0; i < warmed.size(); ++i) {
+            ASSERT_EQ(i, warmed[i]);
+         }
+         warmed.clear();
+      }
+      ASSERT_EQ(13u, tp.getThreadCount());
+
+      std::atomic_int counter{ 0 };
+      for(auto i = 0; i < 100; ++i) {
+         tp.submit([&counter] { ++counter; });
+      }
+      tp.finishAllJobs();
+      ASSERT_EQ(100, counter);
+
+      tp.setThreadCount(5);
+      std::scoped_lock lock{ mutex };
+      ASSERT_EQ(5u, warmed.size());
+   }
+
+#if defined(__linux__)
+   TEST(ThreadOptions, StackSizeAppliesToWorkersAndBlockingThreads) {
+      constexpr std::size_t STACK_SIZE = 256 * 1024;
+      auto                  stackSize  = [] {
+         pthread_attr_t attributes;
+         std::size_t    size = 0;
+         pthread_getattr_np(pthread_self(), &attributes);
+         pthread_attr_getstacksize(&attributes, &size);
+         pthread_attr_destroy(&attributes);
+         return size;
+      };
+
+      TnT::TnTThreadPool tp{ 2, TnT::ThreadOptions{ .stackSize = STACK_SIZE } };
+      auto               worker = tp.submitForReturn(stackSize).get();
+      ASSERT_GE(worker, STACK_SIZE);
+      ASSERT_LT(worker, 2 * STACK_SIZE);
+
+      std::promise<std::size_t> blocking;
+      tp.submitBlocking([&blocking, &stackSize] { blocking.set_value(stackSize()); });
+      ASSERT_EQ(worker, blocking.get_future().get());
+   }
+#endif
+
+   /* TypedWorkQueue */
+   struct SumHandler {
+      std::atomic_llong* sum;
+      inline void        operator()(int& item) const { *sum += item; }
+   };
+
+   TEST(TypedWorkQueue, HandlesEveryItem) {
+      std::atomic_llong  sum{ 0 };
+      TnT::TnTThreadPool tp{ 4 };
+      {
+         TnT::TypedWorkQueue<int, SumHandler> queue{ tp, SumHandler{ &sum }, 64 };
+         for(int i = 1; i <= 10000; ++i) {
+            queue.push(i);
+         }
+         queue.wait();
+         ASSERT_EQ(50005000, sum);
+
+         std::vector<int> items(1000, 2);
+         queue.pushRange(items);
+      }
+      ASSERT_EQ(50007000, sum);
+   }
+
+   TEST(TypedWorkQueue, BatchHandlerSeesContiguousBatches) {
+      std::atomic_int    handled{ 0 };
+      std::atomic_bool   oversized{ false };
+      TnT::TnTThreadPool tp{ 2 };
+      auto               handler = [&handled, &oversized](std::span<std::string> batch) {
+         if(batch.size() > 32) {
+            oversized = true;
+         }
+         for(auto& item: batch) {
+            handled += static_cast<int>(item.size());
+         }
+      };
+
+      TnT::TypedWorkQueue<std::string, decltype(handler)> queue{ tp, handler, 32 };
+      for(auto i = 0; i < 500; ++i) {
+         queue.emplace(3, 'x');
+      }
+      queue.wait();
+      ASSERT_EQ(1500, handled);
+      ASSERT_FALSE(oversized);
+      ASSERT_EQ(0u, queue.size());
+   }
+
+   TEST(TypedWorkQueue, WaitRethrowsHandlerException) {
+      TnT::TnTThreadPool tp{ 2 };
+      auto               handler = [](int& item) {
+         if(item == 7) {
+            throw std::runtime_error("bad item");
+         }
+      };
+
+      TnT::TypedWorkQueue<int, decltype(handler)> queue{ tp, handler };
+      for(int i = 0; i < 10; ++i) {
+         queue.push(i);
+      }
+      ASSERT_THROW(queue.wait(), std::runtime_error);
+      queue.push(1);
+      ASSERT_NO_THROW(queue.wait());
+   }
+
+   /* MicroBatcher */
+   TEST(MicroBatcher, DispatchesFullBatchesThenTheRemainder) {
+      std::mutex               mutex;
+      std::vector<std::size_t> sizes;
+      int                      sum = 0;
+      auto                     handler = [&mutex, &sizes, &sum](std::span<int> batch) {
+         std::scoped_lock lock{ mutex };
+         sizes.push_back(batch.size());
+         for(int item: batch) {
+            sum += item;
+         }
+      };
+
+      TnT::TnTThreadPool tp{ 2 };
+      TnT::MicroBatcher<int, decltype(handler)> batcher{ tp, handler, 10, std::chrono::seconds(10) };
+      for(int i = 1; i <= 25; ++i) {
+         batcher.submit(i);
+      }
+      batcher.wait();
+
+      std::scoped_lock lock{ mutex };
+      std::ranges::sort(sizes);
+      ASSERT_EQ((std::vector<std::size_t>{ 5, 10, 10 }), sizes);
+      ASSERT_EQ(325, sum);
+   }
+
+   TEST(MicroBatcher, FlushesAfterMaxDelay) {
+      std::promise<std::size_t> handled;
+      auto                      handler = [&handled](std::span<std::string> batch) { handled.set_value(batch.size()); };
+
+      TnT::TnTThreadPool tp{ 1 };
+      TnT::MicroBatcher<std::string, decltype(handler)> batcher{ tp, handler, 1000, std::chrono::milliseconds(2) };
+      batcher.emplace("a");
+      batcher.emplace("b");
+      batcher.emplace("c");
+
+      // Nothing flushes the batch but its deadline.
+      auto result = handled.get_future();
+      ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(5)));
+      ASSERT_EQ(3u, result.get());
+   }
+
+   /* SubmitForReturnKeyed */
+   TEST(SubmitForReturnKeyed, EqualKeysShareOneExecution) {
+      TnT::TnTThreadPool tp{ 2 };
+      std::atomic_int    runs{ 0 };
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      auto               job      = [&runs, released](int value) {
+         released.wait();
+         ++runs;
+         return value * 2;
+      };
+
+      auto first  = tp.submitForReturnKeyed(std::string{ "key" }, job, 21);
+      auto second = tp.submitForReturnKeyed(std::string{ "key" }, job, 100);
+      auto other  = tp.submitForReturnKeyed(std::string{ "other" }, job, 5);
+      release.set_value();
+
+      ASSERT_EQ(42, first.get());
+      ASSERT_EQ(42, second.get());
+      ASSERT_EQ(10, other.get());
+      ASSERT_EQ(2, runs.load());
+
+      // Once finished, the key runs again.
+      ASSERT_EQ(200, tp.submitForReturnKeyed(std::string{ "key" }, job, 100).get());
+      ASSERT_EQ(3, runs.load());
+   }
+
+   TEST(SubmitForReturnKeyed, SharesExceptions) {
+      TnT::TnTThreadPool tp{ 1 };
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      auto               job      = [released]() -> int {
+         released.wait();
+         throw std::runtime_error("failed");
+      };
+
+      auto first  = tp.submitForReturnKeyed(7, job);
+      auto second = tp.submitForReturnKeyed(7, job);
+      release.set_value();
+      ASSERT_THROW(first.get(), std::runtime_error);
+      ASSERT_THROW(second.get(), std::runtime_error);
+   }
+
+   /* SubmitForReturnMemoized */
+   TEST(SubmitForReturnMemoized, ReturnsCachedResultsWithoutRunning) {
+      TnT::TnTThreadPool tp{ 2 };
+      std::atomic_int    runs{ 0 };
+      auto               job = [&runs](int value) {
+         ++runs;
+         return value * 2;
+      };
+
+      ASSERT_EQ(42, tp.submitForReturnMemoized(1, job, 21).get());
+      auto cached = tp.submitForReturnMemoized(1, job, 100);
+      ASSERT_EQ(std::future_status::ready, cached.wait_for(std::chrono::seconds(0)));
+      ASSERT_EQ(42, cached.get());
+      ASSERT_EQ(1, runs.load());
+
+      tp.clearResultCache();
+      ASSERT_EQ(200, tp.submitForReturnMemoized(1, job, 100).get());
+      ASSERT_EQ(2, runs.load());
+   }
+
+   TEST(SubmitForReturnMemoized, EvictsExpiredAndFailedResults) {
+      TnT::TnTThreadPool tp{ 1 };
+      std::atomic_int    runs{ 0 };
+      auto               job = [&runs](bool fail) {
+         ++runs;
+         if(fail) {
+            throw std::runtime_error("failed");
+         }
+         return 1;
+      };
+
+      ASSERT_THROW(tp.submitForReturnMemoized(std::string{ "key" }, job, true).get(), std::runtime_error);
+      ASSERT_EQ(1, tp.submitForReturnMemoized(std::string{ "key" }, job, false).get());
+      ASSERT_EQ(2, runs.load());
+
+      tp.setResultCacheLimits(16, std::chrono::milliseconds(1));
+      ASSERT_EQ(1, tp.submitForReturnMemoized(std::string{ "other" }, job, false).get());
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      ASSERT_EQ(1, tp.submitForReturnMemoized(std::string{ "other" }, job, false).get());
+      ASSERT_EQ(4, runs.load());
+   }
+
+   TEST(SubmitForReturnMemoized, StaysWithinCapacity) {
+      TnT::TnTThreadPool tp{ 1 };
+      std::atomic_int    runs{ 0 };
+      auto               job = [&runs](int value) {
+         ++runs;
+         return value;
+      };
+
+      // One result per stripe.
+      tp.setResultCacheLimits(1);
+      for(int i = 0; i < 1000; ++i) {
+         ASSERT_EQ(i, tp.submitForReturnMemoized(i, job, i).get());
+      }
+      for(int i = 0; i < 1000; ++i) {
+         ASSERT_EQ(i, tp.submitForReturnMemoized(i, job, i).get());
+      }
+      ASSERT_GE(runs.load(), 2000 - 64);
+   }
+
+   /* SubmitHedged */
+   TEST(SubmitHedged, DuplicateWinsWhenFirstStalls) {
+      TnT::TnTThreadPool tp{ 2 };
+      std::atomic_int    calls{ 0 };
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      auto               job      = [&calls, released] {
+         if(calls++ == 0) {
+            released.wait();
+            return 1;
+         }
+         return 2;
+      };
+
+      auto result = tp.submitHedged(std::chrono::milliseconds(1), job);
+      ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(5)));
+      ASSERT_EQ(2, result.get());
+      release.set_value();
+      tp.finishAllJobs();
+      ASSERT_EQ(2, calls.load());
+   }
+
+   TEST(SubmitHedged, SkipsDuplicateOfFinishedJob) {
+      TnT::TnTThreadPool tp{ 2 };
+      std::atomic_int    calls{ 0 };
+
+      const auto submitted = std::chrono::steady_clock::now();
+      ASSERT_EQ(5, tp.submitHedged(std::chrono::milliseconds(500), [&calls](int value) { ++calls; return value; }, 5).get());
+      std::this_thread::sleep_until(submitted + std::chrono::milliseconds(600));
+      tp.finishAllJobs();
+      ASSERT_EQ(1, calls.load());
+   }
+
+   TEST(SubmitHedged, FinishAllJobsWaitsForDuplicates) {
+      TnT::TnTThreadPool tp{ 2 };
+      std::vector<std::future<int>> results;
+      for(int i = 0; i < 20; ++i) {
+         auto calls = std::make_shared<std::atomic_int>(0);
+         results.push_back(tp.submitHedged(std::chrono::milliseconds(1), [calls]() -> int {
+            if(calls->fetch_add(1) == 0) {
+               std::this_thread::sleep_for(std::chrono::milliseconds(2));
+               throw std::runtime_error("failed");
+            }
+            return 2;
+         }));
+      }
+
+      tp.finishAllJobs();
+      for(auto& result: results) {
+         ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(0)));
+      }
+   }
+
+   TEST(SubmitHedged, PercentileSamplesFailedFirstCopies) {
+      TnT::TnTThreadPool tp{ 2 };
+      tp.setHedgePercentile(50);
+      for(int i = 0; i < 40; ++i) {
+         auto failing = tp.submitHedged(std::chrono::hours(1), []() -> int {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            throw std::runtime_error("failed");
+         });
+         ASSERT_THROW(failing.get(), std::runtime_error);
+      }
+
+      // With the failures sampled, the duplicate goes out after about a millisecond rather than an hour.
+      std::atomic_int    calls{ 0 };
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      auto               result   = tp.submitHedged(std::chrono::hours(1), [&calls, released] {
+         if(calls++ == 0) {
+            released.wait();
+            return 1;
+         }
+         return 2;
+      });
+      ASSERT_EQ(std::future_status::ready, result.wait_for(std::chrono::seconds(5)));
+      ASSERT_EQ(2, result.get());
+      release.set_value();
+      tp.finishAllJobs();
+   }
+
+   TEST(SubmitHedged, RethrowsWhenBothCopiesFail) {
+      TnT::TnTThreadPool tp{ 2 };
+      std::atomic_int    calls{ 0 };
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      auto               job      = [&calls, released]() -> int {
+         if(calls++ == 0) {
+            released.wait();
+         }
+         throw std::runtime_error("failed");
+      };
+
+      auto result = tp.submitHedged(std::chrono::milliseconds(1), job);
+      // The duplicate fails first, so the future waits for the stalled copy.
+      ASSERT_EQ(std::future_status::timeout, result.wait_for(std::chrono::milliseconds(50)));
+      release.set_value();
+      ASSERT_THROW(result.get(), std::runtime_error);
+   }
+
+   /* SubmitForReturnClaimable */
+   TEST(SubmitForReturnClaimable, WaiterRunsQueuedJobInline) {
+      TnT::TnTThreadPool tp{ 1 };
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      tp.submit([released] { released.wait(); });
+
+      std::atomic_int runs{ 0 };
+      auto            result = tp.submitForReturnClaimable([&runs] {
+         ++runs;
+         return std::this_thread::get_id();
+      });
+
+      // The only worker is busy, so the job runs here.
+      ASSERT_EQ(std::this_thread::get_id(), result.get());
+      release.set_value();
+      tp.finishAllJobs();
+      ASSERT_EQ(1, runs.load());
+   }
+
+   TEST(SubmitForReturnClaimable, WaitsForJobAWorkerClaimed) {
+      TnT::TnTThreadPool tp{ 1 };
+      std::promise<void> started;
+      std::promise<void> release;
+      auto               released = release.get_future().share();
+      auto               result   = tp.submitForReturnClaimable([&started, released](int value) {
+         started.set_value();
+         released.wait();
+         return value;
+      }, 7);
+
+      started.get_future().wait();
+      ASSERT_FALSE(result.runIfPending());
+      release.set_value();
+      ASSERT_EQ(7, result.get());
+   }
+
+   /* CompletionQueue */
+   TEST(CompletionQueue, PopsInCompletionOrder) {
+      TnT::TnTThreadPool        tp{ 2 };
+      TnT::CompletionQueue<int> queue{ tp };
+      std::promise<void>        release;
+      auto                      released = release.get_future().share();
+
+      queue.submit([released] {
+         released.wait();
+         return 1;
+      });
+      queue.submit([](int value) { return value; }, 2);
+
+      ASSERT_EQ(2, queue.pop());
+      ASSERT_FALSE(queue.tryPop().has_value());
+      release.set_value();
+      ASSERT_EQ(1, queue.pop());
+      ASSERT_THROW(static_cast<void>(queue.pop()), std::runtime_error);
+   }
+
+   TEST(CompletionQueue, PopBatchStopsAtFailedJob) {
+      TnT::TnTThreadPool                tp{ 1 };
+      TnT::CompletionQueue<std::string> queue{ tp };
+      for(int i = 0; i < 10; ++i) {
+         queue.submit([i]() -> std::string {
+            if(i == 5) {
+               throw std::runtime_error("failed");
+            }
+            return std::to_string(i);
+         });
+      }
+      tp.finishAllJobs();
+
+      // One worker finishes the jobs in submission order.
+      std::vector<std::string> results;
+      ASSERT_EQ(5u, queue.popBatch(results, 100));
+      ASSERT_THROW(queue.popBatch(results, 100), std::runtime_error);
+      ASSERT_EQ(4u, queue.popBatch(results, 100));
+      ASSERT_EQ(9u, results.size());
+      ASSERT_EQ(0u, queue.popBatch(results, 100));
+   }
+
+   /* CpuBudget */
+   TEST(CpuBudget, NeverExceedsCapacityAcrossPools) {
+      TnT::CpuBudget  budget{ 2 };
+      std::atomic_int running{ 0 };
+      std::atomic_int peak{ 0 };
+      auto            job = [&running, &peak] {
+         int now = ++running;
+         int seen = peak;
+         while(now > seen && !peak.compare_exchange_weak(seen, now)) {}
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         --running;
+      };
+
+      TnT::TnTThreadPool first{ 4 };
+      TnT::TnTThreadPool second{ 4 };
+      first.setCpuBudget(&budget);
+      second.setCpuBudget(&budget);
+      for(auto i = 0; i < 40; ++i) {
+         first.submit(job);
+         second.submit(job);
+      }
+      first.finishAllJobs();
+      second.finishAllJobs();
+
+      ASSERT_LE(peak, 2);
+      ASSERT_GE(peak, 1);
+   }
+
+   TEST(CpuBudget, IdlePoolLendsItsTokens) {
+      TnT::CpuBudget     budget{ 2 };
+      TnT::TnTThreadPool idle{ 2 };
+      TnT::TnTThreadPool busy{ 2 };
+      idle.setCpuBudget(&budget);
+      busy.setCpuBudget(&budget);
+      ASSERT_EQ(&budget, busy.getCpuBudget());
+
+      // Both jobs can only finish if they run at the same time, which needs both of the budget's tokens.
+      std::latch together{ 2 };
+      auto       first  = busy.submitWaitable([&together] { together.arrive_and_wait(); });
+      auto       second = busy.submitWaitable([&together] { together.arrive_and_wait(); });
+      ASSERT_NE(std::future_status::timeout, first.wait_for(DEFAULT_STALL_TIME * 50));
+      ASSERT_NE(std::future_status::timeout, second.wait_for(DEFAULT_STALL_TIME * 50));
+   }
+
+   TEST(CpuBudget, BusyPoolDoesNotStarveOthers) {
+      TnT::CpuBudget     budget{ 1 };
+      TnT::TnTThreadPool busy{ 1 };
+      TnT::TnTThreadPool other{ 1 };
+      busy.setCpuBudget(&budget);
+      other.setCpuBudget(&budget);
+
+      constexpr int   jobCount = 200;
+      std::atomic_int finished{ 0 };
+      for(auto i = 0; i < jobCount; ++i) {
+         busy.submit([&finished] {
+            std::this_thread::sleep_for(1ms);
+            ++finished;
+         });
+      }
+
+      while(finished == 0) {
+         std::this_thread::yield();
+      }
+
+      // The busy pool's worker holds the only token and never runs out of work, so this only runs if it hands the token over between jobs.
+      auto turn = other.submitWaitable([] {});
+      ASSERT_NE(std::future_status::timeout, turn.wait_for(DEFAULT_STALL_TIME * 50));
+      ASSERT_LT(finished, jobCount);
+      busy.finishAllJobs();
+   }
+
+   TEST(CpuBudget, BlockingRegionHandsBackItsToken) {
+      TnT::CpuBudget     budget{ 1 };
+      TnT::TnTThreadPool tp{ 1 };
+      tp.setCpuBudget(&budget);
+
+      std::latch release{ 1 };
+      tp.submit([&release] {
+         TnT::blockingRegion region;
+         release.wait();
+      });
+
+      // The spare worker needs the token the blocked worker handed back to run this.
+      auto unblocker = tp.submitWaitable([&release] { release.count_down(); });
+      ASSERT_NE(std::future_status::timeout, unblocker.wait_for(DEFAULT_STALL_TIME * 50));
+      tp.finishAllJobs();
+
+      tp.setCpuBudget(nullptr);
+      ASSERT_EQ(nullptr, tp.getCpuBudget());
+   }
+
    /* Stress Tests */
    TEST(StressTest, AddLargeNumberOfItems) {
       std::mutex         mutex;
@@ -604,7 +1733,7 @@ namespace Concurrency {
       }
 
       auto expectedStr = expected.str();
-      for(auto i = 0; i < vec.size(); ++i) {
+      for(std::size_t i = 0; i < vec.size(); ++i) {
          ASSERT_EQ(expectedStr, vec[i]) << " Failed at index " << i;
       }
    }
@@ -667,6 +1796,118 @@ namespace Concurrency {
       }
    }
 
+   /* SubmitBlocking */
+   TEST(SubmitBlocking, GrowsBeyondWorkerCountWithoutStallingCpuJobs) {
+      constexpr std::ptrdiff_t blockingJobs = 8;
+      std::latch               allBlocked{ blockingJobs };
+      std::latch               release{ 1 };
+
+      TnT::TnTThreadPool tp{ 1 };
+      for(std::ptrdiff_t i = 0; i < blockingJobs; ++i) {
+         tp.submitBlocking([&] {
+            allBlocked.count_down();
+            release.wait();
+         });
+      }
+
+      // Every blocking job is parked at once, yet the single CPU worker is still free.
+      allBlocked.wait();
+      ASSERT_EQ(static_cast<std::size_t>(blockingJobs), tp.getBlockingThreadCount());
+
+      auto cpuJob = tp.submitForReturn<int>(functionReturnValueWithArgs, 5);
+      ASSERT_NE(std::future_status::timeout, cpuJob.wait_for(DEFAULT_STALL_TIME * 50));
+      ASSERT_EQ(25, cpuJob.get());
+
+      release.count_down();
+      tp.finishAllJobs();
+   }
+
+   TEST(SubmitBlocking, IdleThreadsRetire) {
+      TnT::TnTThreadPool tp{ 1 };
+      tp.setBlockingKeepAlive(1ms);
+      tp.setMaxBlockingThreadCount(2);
+
+      std::atomic_int counter{ 0 };
+      for(auto i = 0; i < 10; ++i) {
+         tp.submitBlocking([&counter](int amount) { counter += amount; }, 2);
+      }
+      tp.finishAllJobs();
+      ASSERT_EQ(20, counter);
+      ASSERT_LE(tp.getBlockingThreadCount(), 2u);
+
+      auto deadline = std::chrono::steady_clock::now() + DEFAULT_STALL_TIME * 100;
+      while(tp.getBlockingThreadCount() != 0 && std::chrono::steady_clock::now() < deadline) {
+         std::this_thread::sleep_for(1ms);
+      }
+      ASSERT_EQ(0u, tp.getBlockingThreadCount());
+
+      tp.submitBlocking([&counter] { ++counter; });
+      tp.finishAllJobs();
+      ASSERT_EQ(21, counter);
+   }
+
+   TEST(SubmitBlocking, ThrowsAfterShutdown) {
+      TnT::TnTThreadPool tp{ 1 };
+      tp.shutdown();
+      ASSERT_THROW(tp.submitBlocking([] {}), std::runtime_error);
+      tp.reset(1);
+      auto done = std::make_shared<std::promise<void>>();
+      tp.submitBlocking([done] { done->set_value(); });
+      ASSERT_NE(std::future_status::timeout, done->get_future().wait_for(DEFAULT_STALL_TIME * 50));
+   }
+
+   /* BlockingRegion */
+   TEST(BlockingRegion, SpareWorkerKeepsQueueMoving) {
+      std::latch release{ 1 };
+
+      TnT::TnTThreadPool tp{ 1 };
+      tp.submit([&release] {
+         TnT::blockingRegion region;
+         release.wait();
+      });
+
+      // Without a compensating worker this job would never start, as the only worker is blocked until it runs.
+      auto unblocker = tp.submitWaitable([&release] { release.count_down(); });
+      ASSERT_NE(std::future_status::timeout, unblocker.wait_for(DEFAULT_STALL_TIME * 50));
+
+      tp.finishAllJobs();
+      ASSERT_EQ(1u, tp.getThreadCount());
+   }
+
+   TEST(BlockingRegion, SparesAreReusedAcrossRegions) {
+      std::atomic_int counter{ 0 };
+
+      TnT::TnTThreadPool tp{ 2 };
+      for(auto round = 0; round < 5; ++round) {
+         std::latch release{ 1 };
+         for(auto i = 0; i < 2; ++i) {
+            tp.submit([&release] {
+               TnT::blockingRegion region;
+               release.wait();
+            });
+         }
+         for(auto i = 0; i < 100; ++i) {
+            tp.submit([&counter] { ++counter; });
+         }
+         tp.submit([&release] { release.count_down(); });
+         tp.finishAllJobs();
+      }
+      ASSERT_EQ(500, counter);
+      ASSERT_EQ(2u, tp.getThreadCount());
+   }
+
+   TEST(BlockingRegion, NoOpOutsideThePool) {
+      TnT::TnTThreadPool tp{ 1 };
+      {
+         TnT::blockingRegion region;
+         ASSERT_EQ(0u, tp.getSpareThreadCount());
+      }
+
+      // The same region entered from a worker does start a spare.
+      tp.submitWaitable([] { TnT::blockingRegion region; }).wait();
+      ASSERT_EQ(1u, tp.getSpareThreadCount());
+   }
+
    /* For Each*/
 
    TEST(ForEachTest, NonTrivialForEach) {
@@ -688,6 +1929,57 @@ namespace Concurrency {
       ASSERT_EQ(expected, accumulator);
    }
 
+   TEST(ForEachTest, LargerThanInlineArena) {
+      std::vector<std::int64_t> nums(100000);
+      std::iota(nums.begin(), nums.end(), 0);
+      auto expected = std::accumulate(nums.begin(), nums.end(), std::int64_t{ 0 });
+
+      TnT::TnTThreadPool tp;
+
+      std::atomic<std::int64_t> accumulator{ 0 };
+      tp.forEach([&accumulator](std::int64_t num) { accumulator += num; }, nums);
+
+      ASSERT_EQ(expected, accumulator);
+   }
+
+   TEST(ForEachTest, UnsizedContainer) {
+      std::forward_list<std::string> words{ "thread", "pool", "arena" };
+
+      TnT::TnTThreadPool tp;
+
+      std::atomic_size_t totalLength{ 0 };
+      tp.forEach([&totalLength](std::string& word) { totalLength += word.size(); }, words);
+
+      ASSERT_EQ(15u, totalLength);
+   }
+
+   TEST(ForEachTest, ModifiesElementsInPlaceWithoutCopying) {
+      std::vector<std::unique_ptr<int>>       numbers;
+      std::forward_list<std::unique_ptr<int>> unsized;
+      for(auto i = 0; i < 100; ++i) {
+         numbers.push_back(std::make_unique<int>(i));
+         unsized.push_front(std::make_unique<int>(i));
+      }
+
+      TnT::TnTThreadPool tp;
+      tp.forEach([](std::unique_ptr<int>& number) { *number *= 2; }, numbers);
+      tp.forEach([](std::unique_ptr<int>& number) { number.reset(); }, unsized);
+
+      for(auto i = 0; i < 100; ++i) {
+         ASSERT_EQ(i * 2, *numbers[static_cast<std::size_t>(i)]);
+      }
+      ASSERT_TRUE(std::ranges::all_of(unsized, [](const auto& number) { return number == nullptr; }));
+   }
+
+   TEST(ForEachTest, FreeFunction) {
+      std::array nums{ 2, 3, 5, 7, 11 };
+
+      std::atomic_int accumulator{ 0 };
+      TnT::forEach([&accumulator](int num) { accumulator += num; }, nums, 2);
+
+      ASSERT_EQ(28, accumulator);
+   }
+
    /* For Each Indexed */
    TEST(ForEachIndexedTest, NonTrivialForEach) {
       std::mutex mutex;
@@ -700,7 +1992,7 @@ namespace Concurrency {
       tp.forEachIndexed<std::int32_t>(
           [&mutex, &accumulator, &nums](auto index) {
              std::scoped_lock lock{ mutex };
-             accumulator += nums[index];
+             accumulator += nums[static_cast<std::size_t>(index)];
           },
           0,
           static_cast<std::int32_t>(nums.size()));
@@ -708,6 +2000,13 @@ namespace Concurrency {
       ASSERT_EQ(expected, accumulator);
    }
 
+   TEST(ForEachIndexedTest, FreeFunctionWithIncrement) {
+      std::atomic_int accumulator{ 0 };
+      TnT::forEachIndexed<int>([&accumulator](int index) { accumulator += index; }, 0, 10, 3, 2);
+
+      ASSERT_EQ(0 + 3 + 6 + 9, accumulator);
+   }
+
    TEST(ShutdownThreadPoolThenQueueJob, ShutdownThreadPoolThenQueueJobWithoutReset) {
       std::mutex mutex;
 
@@ -780,4 +2079,271 @@ namespace Concurrency {
       ASSERT_EQ(iterations, value);
    }
 
+#if defined(TNT_HAS_IO_URING)
+   /* AsyncFileIO */
+   TEST(AsyncFileIO, WriteThenReadBack) {
+      TnT::TnTThreadPool tp;
+
+      std::unique_ptr<TnT::AsyncFileIO> io;
+      try {
+         io = std::make_unique<TnT::AsyncFileIO>(tp);
+      }
+      catch(const std::system_error& e) {
+         GTEST_SKIP() << "io_uring unavailable: " << e.what();
+      }
+
+      std::FILE* file = std::tmpfile();
+      ASSERT_NE(nullptr, file);
+      const int fd = fileno(file);
+
+      const std::string expected = "TnTThreadPool io_uring";
+      auto              written  = io->writeForResult(fd, expected.data(), static_cast<std::uint32_t>(expected.size()), 0);
+      io->submit();
+      ASSERT_EQ(static_cast<std::int32_t>(expected.size()), written.get());
+
+      std::string               buffer(expected.size(), '\0');
+      std::promise<std::int32_t> readResult;
+      std::thread::id            continuationThread;
+      io->read(fd, buffer.data(), static_cast<std::uint32_t>(buffer.size()), 0, [&](std::int32_t result) {
+         continuationThread = std::this_thread::get_id();
+         readResult.set_value(result);
+      });
+      io->submit();
+
+      ASSERT_EQ(static_cast<std::int32_t>(expected.size()), readResult.get_future().get());
+      ASSERT_EQ(expected, buffer);
+      ASSERT_NE(MAIN_THREAD_ID, continuationThread);
+
+      io.reset();
+      std::fclose(file);
+   }
+
+   TEST(AsyncFileIO, BatchedReads) {
+      TnT::TnTThreadPool tp;
+
+      std::unique_ptr<TnT::AsyncFileIO> io;
+      try {
+         io = std::make_unique<TnT::AsyncFileIO>(tp, 8);
+      }
+      catch(const std::system_error& e) {
+         GTEST_SKIP() << "io_uring unavailable: " << e.what();
+      }
+
+      std::FILE* file = std::tmpfile();
+      ASSERT_NE(nullptr, file);
+      std::vector<char> contents(4096);
+      std::iota(contents.begin(), contents.end(), 0);
+      std::fwrite(contents.data(), 1, contents.size(), file);
+      std::fflush(file);
+      const int fd = fileno(file);
+
+      // More requests than ring entries forces intermediate flushes.
+      constexpr std::size_t             chunk = 64;
+      std::vector<char>                 buffer(contents.size());
+      std::vector<std::future<std::int32_t>> results;
+      for(std::size_t offset = 0; offset < contents.size(); offset += chunk) {
+         results.push_back(io->readForResult(fd, buffer.data() + offset, chunk, offset));
+      }
+      io->submit();
+
+      for(auto& result: results) {
+         ASSERT_EQ(static_cast<std::int32_t>(chunk), result.get());
+      }
+      ASSERT_EQ(contents, buffer);
+
+      io.reset();
+      std::fclose(file);
+   }
+
+   TEST(AsyncFileIO, RunsContinuationInlineAfterPoolShutdown) {
+      TnT::TnTThreadPool tp;
+
+      std::unique_ptr<TnT::AsyncFileIO> io;
+      try {
+         io = std::make_unique<TnT::AsyncFileIO>(tp);
+      }
+      catch(const std::system_error& e) {
+         GTEST_SKIP() << "io_uring unavailable: " << e.what();
+      }
+
+      std::FILE* file = std::tmpfile();
+      ASSERT_NE(nullptr, file);
+      const std::string expected = "shutdown";
+      std::fwrite(expected.data(), 1, expected.size(), file);
+      std::fflush(file);
+
+      tp.shutdown();
+
+      std::string               buffer(expected.size(), '\0');
+      std::promise<std::int32_t> readResult;
+      io->read(fileno(file), buffer.data(), static_cast<std::uint32_t>(buffer.size()), 0, [&](std::int32_t result) { readResult.set_value(result); });
+      io->submit();
+
+      ASSERT_EQ(static_cast<std::int32_t>(expected.size()), readResult.get_future().get());
+      ASSERT_EQ(expected, buffer);
+
+      io.reset();
+      std::fclose(file);
+   }
+
+   TEST(AsyncFileIO, SubmitRethrowsContinuationException) {
+      TnT::TnTThreadPool tp;
+
+      std::unique_ptr<TnT::AsyncFileIO> io;
+      try {
+         io = std::make_unique<TnT::AsyncFileIO>(tp);
+      }
+      catch(const std::system_error& e) {
+         GTEST_SKIP() << "io_uring unavailable: " << e.what();
+      }
+
+      std::FILE* file = std::tmpfile();
+      ASSERT_NE(nullptr, file);
+      std::fputs("throws", file);
+      std::fflush(file);
+
+      // The continuation may still be in flight, so submit is retried until it rethrows.
+      auto submitUntilThrows = [&io] {
+         const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+         while(std::chrono::steady_clock::now() < deadline) {
+            try {
+               io->submit();
+            }
+            catch(...) {
+               return std::current_exception();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+         return std::exception_ptr{};
+      };
+
+      std::string buffer(6, '\0');
+      io->read(fileno(file), buffer.data(), static_cast<std::uint32_t>(buffer.size()), 0, [](std::int32_t) { throw std::runtime_error("continuation failed"); });
+      const auto pooled = submitUntilThrows();
+      ASSERT_TRUE(pooled);
+      ASSERT_THROW(std::rethrow_exception(pooled), std::runtime_error);
+
+      // Without the pool, the continuation throws inline on the reaper.
+      tp.shutdown();
+      io->read(fileno(file), buffer.data(), static_cast<std::uint32_t>(buffer.size()), 0, [](std::int32_t) { throw std::logic_error("inline failure"); });
+      const auto inlined = submitUntilThrows();
+      ASSERT_TRUE(inlined);
+      ASSERT_THROW(std::rethrow_exception(inlined), std::logic_error);
+
+      auto result = io->readForResult(fileno(file), buffer.data(), static_cast<std::uint32_t>(buffer.size()), 0);
+      io->submit();
+      ASSERT_EQ(6, result.get());
+
+      io.reset();
+      std::fclose(file);
+   }
+#endif
+
+#if defined(TNT_HAS_EPOLL)
+   /* Reactor */
+   TEST(Reactor, DispatchesReadinessOnWorker) {
+      int sockets[2];
+      ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+      std::promise<char> received;
+      std::thread::id    callbackThread;
+      {
+         TnT::TnTThreadPool tp;
+         tp.registerFd(sockets[0], EPOLLIN, [&](std::uint32_t events) {
+            ASSERT_TRUE(events & EPOLLIN);
+            char value{};
+            ASSERT_EQ(1, read(sockets[0], &value, 1));
+            callbackThread = std::this_thread::get_id();
+            received.set_value(value);
+         });
+
+         const char value = 'T';
+         ASSERT_EQ(1, write(sockets[1], &value, 1));
+
+         auto future = received.get_future();
+         ASSERT_NE(std::future_status::timeout, future.wait_for(DEFAULT_STALL_TIME * 50));
+         ASSERT_EQ(value, future.get());
+         tp.unregisterFd(sockets[0]);
+      }
+      ASSERT_NE(MAIN_THREAD_ID, callbackThread);
+
+      close(sockets[0]);
+      close(sockets[1]);
+   }
+
+   TEST(Reactor, RearmsAfterEachCallbackAcrossManyFds) {
+      constexpr std::size_t        pairCount = 8;
+      constexpr int                rounds    = 10;
+      std::array<int[2], pairCount> pairs{};
+      for(auto& pair: pairs) {
+         ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+      }
+
+      std::atomic_int received{ 0 };
+      {
+         TnT::TnTThreadPool tp;
+         for(auto& pair: pairs) {
+            int fd = pair[0];
+            tp.registerFd(fd, EPOLLIN, [fd, &received](std::uint32_t) {
+               char value{};
+               while(read(fd, &value, 1) == 1) {
+                  ++received;
+               }
+            });
+            int nonBlocking = 1;
+            ASSERT_EQ(0, ioctl(fd, FIONBIO, &nonBlocking));
+         }
+
+         for(int round = 0; round < rounds; ++round) {
+            for(auto& pair: pairs) {
+               const char value = 'T';
+               ASSERT_EQ(1, write(pair[1], &value, 1));
+            }
+            std::this_thread::sleep_for(1ms);
+         }
+
+         auto deadline = std::chrono::steady_clock::now() + DEFAULT_STALL_TIME * 100;
+         while(received < static_cast<int>(pairCount) * rounds && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+         }
+
+         for(auto& pair: pairs) {
+            tp.unregisterFd(pair[0]);
+         }
+      }
+      ASSERT_EQ(static_cast<int>(pairCount) * rounds, received);
+
+      for(auto& pair: pairs) {
+         close(pair[0]);
+         close(pair[1]);
+      }
+   }
+
+   TEST(Reactor, CallbackClosingItsFdIsUnregistered) {
+      int sockets[2];
+      ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+
+      std::promise<void> closed;
+      {
+         TnT::TnTThreadPool tp;
+         tp.registerFd(sockets[0], EPOLLIN, [&](std::uint32_t) {
+            close(sockets[0]);
+            closed.set_value();
+         });
+
+         const char value = 'T';
+         ASSERT_EQ(1, write(sockets[1], &value, 1));
+
+         auto future = closed.get_future();
+         ASSERT_NE(std::future_status::timeout, future.wait_for(DEFAULT_STALL_TIME * 50));
+
+         // The failed re-arm must not take down the worker, which would terminate the process.
+         ASSERT_EQ(42, tp.submitForReturn([] { return 42; }).get());
+         tp.finishAllJobs();
+      }
+
+      close(sockets[1]);
+   }
+#endif
+
 }   // namespace Concurrency